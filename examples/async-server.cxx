@@ -13,10 +13,10 @@ using namespace bc::async;
 template <network::protocol proto>
 auto async_session(network::socket<proto> &sock) -> task<> {
     while (true) {
-        array<char, 1024> buffer;
-        auto read_res = co_await network::async_read(sock, buffer);
+        // an idle session holds no buffer, one is lent only once data arrives
+        auto read_res = co_await network::async_read_borrowed(sock);
         if (read_res) {
-            auto write_res = co_await network::async_write(sock, {buffer.data(), read_res.value()});
+            auto write_res = co_await network::async_write(sock, *read_res);
             if (!write_res) {
                 log::error("unexpected write error, message: {}", read_res.error().message());
                 break;
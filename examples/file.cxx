@@ -0,0 +1,45 @@
+#include <fcntl.h>
+#include <array>
+#include <string_view>
+#include <fmt/core.h>
+#include <bc/core.hpp>
+
+using namespace std;
+using namespace bc;
+using namespace bc::async;
+
+auto async_copy(file &f) -> task<> {
+    string_view text = "positional writes never block the reactor\n";
+    for (size_t i = 0; i < 4; ++i) {
+        auto n = co_await f.write_at(i * text.size(), text);
+        if (!n) {
+            fmt::print("write failed: {}\n", n.error().message());
+            co_return;
+        }
+    }
+    co_await f.fdatasync();
+
+    array<array<char, 16>, 4> chunks;
+    file_batch batch;
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        batch.read_at(f, i * text.size(), chunks[i]);
+    }
+    auto results = co_await batch.submit();
+    for (size_t i = 0; i < results.size(); ++i) {
+        fmt::print("chunk {}: {}\n", i, string_view(chunks[i].data(), *results[i]));
+    }
+}
+
+auto main(int argc, char **argv) -> int {
+    if (argc > 1 && string_view(argv[1]) == "threads") {
+        set_file_backend(file_backend::THREAD_POOL);
+    }
+    fmt::print("backend: {}\n", current_file_backend() == file_backend::IO_URING ? "io_uring" : "thread pool");
+
+    auto f = file::open("/tmp/bc-file-example", O_RDWR | O_CREAT | O_TRUNC);
+    if (!f) {
+        return 1;
+    }
+    auto t = async_copy(*f);
+    default_scheduler().run();
+}
@@ -0,0 +1,49 @@
+#include <unistd.h>
+#include <array>
+#include <string>
+#include <string_view>
+#include <fmt/core.h>
+#include <bc/core.hpp>
+
+using namespace std;
+using namespace std::chrono_literals;
+using namespace bc;
+using namespace bc::async;
+
+/*
+ * Run it, connect a few clients, then run it again: the new process takes
+ * over the listening socket and new connections, while the old one serves
+ * its clients until they leave and then exits.
+ */
+auto main() -> int {
+    auto control = *network::address::from_path("@bc-hot-restart");
+
+    network::server<network::protocol::TCP, network::domain::IPv4> server("127.0.0.1"sv, 12345);
+    if (auto ec = server.inherit(control, 1s)) {
+        fmt::print("pid {}: cold start, {}\n", ::getpid(), ec.message());
+    }
+    else {
+        fmt::print("pid {}: took over the listener\n", ::getpid());
+    }
+
+    server.start([](network::socket<network::protocol::TCP> &sock) -> task<> {
+        auto greeting = fmt::format("served by pid {}\n", ::getpid());
+        while (true) {
+            array<char, 1024> buffer;
+            auto read_res = co_await network::async_read(sock, buffer);
+            if (!read_res || *read_res == 0) {
+                break;
+            }
+            auto write_res = co_await network::async_write_all(sock, greeting);
+            if (!write_res) {
+                break;
+            }
+        }
+    });
+    server.serve_handoff(control);
+
+    while (!server.draining() || server.stats().live > 0) {
+        default_scheduler().run_for(100ms);
+    }
+    fmt::print("pid {}: drained, {} sessions served\n", ::getpid(), server.stats().completed);
+}
@@ -0,0 +1,70 @@
+#include <chrono>
+#include <string>
+#include <string_view>
+#include <fmt/core.h>
+#include <bc/http/parser.hpp>
+
+using namespace std;
+using namespace bc;
+
+/*
+ * Parser throughput with each scan backend the cpu supports.
+ *
+ * usage: http-parser [iterations]
+ */
+auto main(int argc, char **argv) -> int {
+    auto iterations = argc > 1 ? stoul(argv[1]) : 1'000'000ul;
+
+    // what a browser sends, about 700 bytes
+    string const sample =
+        "GET /api/v1/accounts/12345/transactions?limit=50&cursor=eyJpZCI6IjEyMzQ1Njc4OTAifQ HTTP/1.1\r\n"
+        "Host: api.example.com\r\n"
+        "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/126.0.0.0 Safari/537.36\r\n"
+        "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,*/*;q=0.8\r\n"
+        "Accept-Language: en-US,en;q=0.9\r\n"
+        "Accept-Encoding: gzip, deflate, br, zstd\r\n"
+        "Cookie: session=7c4a8d09ca3762af61e59520943dc26494f8941b; theme=dark; _ga=GA1.1.1234567890.1700000000\r\n"
+        "Referer: https://www.example.com/accounts/12345/overview\r\n"
+        "Cache-Control: no-cache\r\n"
+        "Connection: keep-alive\r\n"
+        "Sec-Fetch-Dest: empty\r\n"
+        "Sec-Fetch-Mode: cors\r\n"
+        "Sec-Fetch-Site: same-site\r\n"
+        "\r\n";
+    // a pipelined batch, parsed one request after another as the server does
+    string batch;
+    for (int i = 0; i < 16; ++i) {
+        batch += sample;
+    }
+
+    auto initial = http::current_scan_backend();
+    for (auto backend : {http::scan_backend::SCALAR, http::scan_backend::SSE42, http::scan_backend::AVX2}) {
+        http::set_scan_backend(backend);
+        if (http::current_scan_backend() != backend) {
+            continue;
+        }
+        http::request req;
+        size_t parsed = 0;
+        auto start = chrono::steady_clock::now();
+        for (size_t i = 0; i < iterations / 16; ++i) {
+            string_view rest = batch;
+            while (!rest.empty()) {
+                auto res = http::parse_request(rest, req);
+                if (!res || *res == 0) {
+                    fmt::print("parse failed\n");
+                    return 1;
+                }
+                rest.remove_prefix(*res);
+                ++parsed;
+            }
+        }
+        chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+        constexpr string_view names[] {"scalar", "sse4.2", "avx2"};
+        fmt::print("{:>7}: {:6.2f} M req/s, {:6.2f} GB/s, {} headers\n",
+            names[static_cast<int>(backend)],
+            parsed / elapsed.count() / 1e6,
+            parsed * sample.size() / elapsed.count() / 1e9,
+            req.headers.size());
+    }
+    http::set_scan_backend(initial);
+}
@@ -0,0 +1,51 @@
+#include <atomic>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <fmt/core.h>
+#include <bc/core.hpp>
+
+using namespace std;
+using namespace std::chrono_literals;
+using namespace bc;
+using namespace bc::async;
+
+/*
+ * usage: http-server [threads]
+ *
+ * try: curl -s localhost:12345/health localhost:12345/metrics
+ */
+auto main(int argc, char **argv) -> int {
+    auto threads = argc > 1 ? stoul(argv[1]) : 0;
+
+    atomic_size_t requests {0};
+    http::server server("127.0.0.1"sv, 12345);
+    server.route("/health", [&](http::request const &, http::response &res) {
+        ++requests;
+        res.set_body_view("ok\n", "text/plain");
+    });
+    server.route("/metrics", [&](http::request const &, http::response &res) {
+        auto stats = server.transport().stats();
+        res.set_body(fmt::format("requests {}\nconnections {}\nrejected {}\n", requests.load(), stats.live, stats.rejected), "text/plain");
+    });
+    server.route("/echo", [&](http::request const &req, http::response &res) {
+        ++requests;
+        if (req.method != "POST") {
+            res.set_status(405).set_header("Allow", "POST");
+            return;
+        }
+        res.set_body(string(req.body), req.header("content-type").value_or("application/octet-stream"));
+    });
+
+    if (threads == 0) {
+        server.start();
+        default_scheduler().run();
+    }
+    else {
+        reactor_pool pool(threads);
+        server.start(pool, network::accept_mode::REUSE_PORT);
+        while (true) {
+            this_thread::sleep_for(1h);
+        }
+    }
+}
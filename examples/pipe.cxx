@@ -0,0 +1,52 @@
+#include <sys/eventfd.h>
+#include <array>
+#include <cstdint>
+#include <fmt/core.h>
+#include <bc/core.hpp>
+
+using namespace std;
+using namespace std::chrono_literals;
+using namespace bc;
+using namespace bc::async;
+
+auto async_produce(fd_stream out, fd_stream &done) -> task<> {
+    for (size_t i = 0; i < 5; ++i) {
+        co_await async_sleep(100ms);
+        auto line = fmt::format("message {}\n", i);
+        co_await async_write(out, line);
+    }
+    out.close();
+    uint64_t one = 1;
+    co_await async_write(done, {reinterpret_cast<char const *>(&one), sizeof(one)});
+}
+
+auto async_consume(fd_stream &in) -> task<> {
+    while (true) {
+        array<char, 1024> buffer;
+        auto n = co_await async_read(in, buffer);
+        if (!n || *n == 0) {
+            break;
+        }
+        fmt::print("read: {}", string_view(buffer.data(), *n));
+    }
+    fmt::print("pipe closed\n");
+}
+
+auto async_notified(fd_stream &done) -> task<> {
+    uint64_t count = 0;
+    co_await async_read(done, {reinterpret_cast<char *>(&count), sizeof(count)});
+    fmt::print("eventfd signalled, count: {}\n", count);
+}
+
+auto main() -> int {
+    // log::default_logger().set_level(bc::log::level::DEBUG);
+
+    auto [in, out] = fd_stream::pipe();
+    auto done = fd_stream::wrap(::eventfd(0, EFD_CLOEXEC));
+
+    auto notified = async_notified(done);
+    auto consumer = async_consume(in);
+    auto producer = async_produce(std::move(out), done);
+
+    default_scheduler().run();
+}
@@ -0,0 +1,39 @@
+#include <array>
+#include <string_view>
+#include <fmt/core.h>
+#include <bc/core.hpp>
+
+using namespace std;
+using namespace bc;
+using namespace bc::async;
+
+auto async_run(size_t id) -> task<> {
+    vector<string> argv {"tr", "a-z", "A-Z"};
+    auto proc = co_await spawn_process(argv);
+    if (!proc) {
+        co_return;
+    }
+    auto line = fmt::format("helper {} says hello\n", id);
+    co_await async_write(proc->in(), line);
+    proc->in().close();
+
+    string output;
+    while (true) {
+        array<char, 256> buffer;
+        auto n = co_await async_read(proc->out(), buffer);
+        if (!n || *n == 0) {
+            break;
+        }
+        output.append(buffer.data(), *n);
+    }
+    auto status = co_await proc->async_wait();
+    fmt::print("pid {} exited with {}: {}", proc->pid(), status ? status->code : -1, output);
+}
+
+auto main() -> int {
+    vector<task<>> tasks;
+    for (size_t i = 0; i < 8; ++i) {
+        tasks.push_back(async_run(i));
+    }
+    default_scheduler().run();
+}
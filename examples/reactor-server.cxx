@@ -0,0 +1,53 @@
+#include <array>
+#include <string_view>
+#include <thread>
+#include <fmt/core.h>
+#include <bc/core.hpp>
+
+using namespace std;
+using namespace std::chrono_literals;
+using namespace bc;
+using namespace bc::async;
+
+/*
+ * usage: reactor-server [dispatch|reuseport|exclusive]
+ */
+auto main(int argc, char **argv) -> int {
+    // log::default_logger().set_level(bc::log::level::DEBUG);
+
+    auto mode = network::accept_mode::DISPATCH;
+    if (argc > 1 && argv[1] == "reuseport"sv) {
+        mode = network::accept_mode::REUSE_PORT;
+    }
+    else if (argc > 1 && argv[1] == "exclusive"sv) {
+        mode = network::accept_mode::EXCLUSIVE;
+    }
+
+    reactor_pool pool(max(thread::hardware_concurrency(), 2u) - 1);
+
+    network::server<network::protocol::TCP, network::domain::IPv4> server("127.0.0.1"sv, 12345);
+    server.start(pool, [](network::socket<network::protocol::TCP> &sock) -> task<> {
+        while (true) {
+            array<char, 1024> buffer;
+            auto read_res = co_await network::async_read(sock, buffer);
+            if (!read_res) {
+                break;
+            }
+            auto write_res = co_await network::async_write(sock, {buffer.data(), read_res.value()});
+            if (!write_res) {
+                log::error("unexpected write error, message: {}", write_res.error().message());
+                break;
+            }
+        }
+    }, mode);
+
+    if (mode == network::accept_mode::DISPATCH) {
+        default_scheduler().run();
+    }
+    else {
+        // the reactors accept on their own threads
+        while (true) {
+            this_thread::sleep_for(1h);
+        }
+    }
+}
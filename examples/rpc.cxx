@@ -0,0 +1,94 @@
+#include <chrono>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <fmt/core.h>
+#include <bc/core.hpp>
+
+using namespace std;
+using namespace std::chrono_literals;
+using namespace bc;
+using namespace bc::async;
+
+struct kv_service {
+    auto echo(string_view payload) -> rpc::result {
+        return string(payload);
+    }
+
+    auto count(string_view) -> rpc::result {
+        return to_string(++calls);
+    }
+
+    /* answers after the payload's number of milliseconds */
+    auto delay(string_view payload) -> task<rpc::result> {
+        co_await async_sleep(chrono::milliseconds(stoi(string(payload))));
+        co_return string(payload);
+    }
+
+    size_t calls {0};
+};
+
+using kv_api = rpc::dispatch_table<kv_service,
+    rpc::method<1, &kv_service::echo>,
+    rpc::method<2, &kv_service::count>,
+    rpc::method<3, &kv_service::delay>
+>;
+
+auto run(rpc::client &client) -> task<> {
+    if (auto ec = co_await client.connect(network::address("127.0.0.1"sv, 12346))) {
+        fmt::print("connect failed: {}\n", ec.message());
+        co_return;
+    }
+
+    // the slow call was sent first and completes last
+    vector<string> order;
+    auto delayed = [&](string ms) -> task<> {
+        auto res = co_await client.call(3, ms);
+        order.push_back(res ? *res : res.error().message());
+    };
+    vector<task<>> calls;
+    for (auto ms : {"30", "20", "10"}) {
+        calls.push_back(delayed(ms));
+    }
+    for (auto &call : calls) {
+        co_await call;
+    }
+    fmt::print("completion order: {} {} {}\n", order[0], order[1], order[2]);
+
+    auto missing = co_await client.call(9, "");
+    fmt::print("unknown method: {}\n", missing.error().message());
+
+    // many callers at once share the connection and its writes
+    size_t done = 0;
+    auto caller = [&](int n) -> task<> {
+        for (int i = 0; i < n; ++i) {
+            auto res = co_await client.call(1, "ping");
+            done += res && *res == "ping";
+        }
+    };
+    auto start = chrono::steady_clock::now();
+    calls.clear();
+    for (int i = 0; i < 256; ++i) {
+        calls.push_back(caller(400));
+    }
+    for (auto &call : calls) {
+        co_await call;
+    }
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    fmt::print("{} calls in flight at once: {} ok, {:.0f} calls/s\n", calls.size(), done, done / elapsed.count());
+    fmt::print("count: {}\n", *co_await client.call(2, ""));
+
+    co_await client.close();
+}
+
+auto main() -> int {
+    kv_service service;
+    rpc::server<kv_api> server("127.0.0.1"sv, 12346, service);
+    server.start();
+
+    rpc::client client;
+    auto task = run(client);
+    while (!task.done()) {
+        default_scheduler().run_until(default_scheduler().now() + 100ms);
+    }
+}
@@ -0,0 +1,47 @@
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <vector>
+#include <fmt/core.h>
+#include <bc/core.hpp>
+
+using namespace std;
+using namespace std::chrono_literals;
+using namespace bc;
+using namespace bc::async;
+
+auto async_keepalive(size_t &beats) -> task<> {
+    uniform_int_distribution<int> jitter(0, 500);
+    for (size_t i = 0; i < 120; ++i) {
+        co_await async_sleep(30s + chrono::milliseconds(jitter(default_scheduler().random())));
+        ++beats;
+    }
+}
+
+auto main() -> int {
+    // log::default_logger().set_level(bc::log::level::DEBUG);
+
+    scheduler simulation(virtual_clock, 42);
+    set_default_scheduler(simulation);
+
+    size_t beats = 0;
+    vector<task<>> connections;
+    for (size_t i = 0; i < 10000; ++i) {
+        connections.push_back(async_keepalive(beats));
+    }
+
+    auto start = chrono::steady_clock::now();
+    simulation.run();
+    auto wall = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start);
+    auto simulated = chrono::duration_cast<chrono::minutes>(simulation.now().time_since_epoch());
+
+    fmt::print("{} keepalives over {} simulated minutes in {} ms\n", beats, simulated.count(), wall.count());
+
+    auto memory = simulation.stats().memory;
+    for (size_t i = 0; i < memory.size(); ++i) {
+        auto const &usage = memory[i];
+        fmt::print("{:>16}: {} bytes in {} objects, peak {} bytes in {} objects\n",
+            utils::memory::category_name(static_cast<utils::memory::category>(i)),
+            usage.bytes, usage.objects, usage.peak_bytes, usage.peak_objects);
+    }
+}
@@ -0,0 +1,75 @@
+#include <unistd.h>
+#include <array>
+#include <fmt/core.h>
+#include <bc/core.hpp>
+
+using namespace std;
+using namespace std::chrono_literals;
+using namespace bc;
+using namespace bc::async;
+
+using stream = network::socket<network::protocol::TCP>;
+
+auto async_ping(stream &sock) -> task<> {
+    for (size_t i = 0; i < 3; ++i) {
+        auto message = fmt::format("ping {}", i);
+        co_await network::async_write(sock, message);
+        array<char, 64> buffer;
+        auto n = co_await network::async_read(sock, buffer);
+        if (!n) {
+            break;
+        }
+        fmt::print("got: {}\n", string_view(buffer.data(), *n));
+    }
+}
+
+auto async_pong(stream &sock) -> task<> {
+    while (true) {
+        array<char, 64> buffer;
+        auto n = co_await network::async_read(sock, buffer);
+        if (!n) {
+            break;
+        }
+        auto reply = fmt::format("pong for '{}'", string_view(buffer.data(), *n));
+        co_await network::async_write(sock, reply);
+    }
+}
+
+auto async_client(network::address addr) -> task<> {
+    stream sock;
+    if (auto ec = co_await sock.async_connect(addr)) {
+        fmt::print("connect failed: {}\n", ec.message());
+        co_return;
+    }
+    auto message = fmt::format("hello from pid {}", ::getpid());
+    co_await network::async_write(sock, message);
+}
+
+auto main() -> int {
+    // a connected pair needs no address at all
+    auto [left, right] = stream::pair();
+    auto pong = async_pong(right);
+    auto ping = async_ping(left);
+
+    // an abstract address never appears in the filesystem
+    auto addr = *network::address::from_path("@bc-unix-example");
+    network::server<network::protocol::TCP, network::domain::UNIX> server(addr);
+    server.start([](stream &sock) -> task<> {
+        auto cred = sock.peer_credentials();
+        if (auto ec = sock.set_pass_credentials(true)) {
+            log::warning("failed to ask for credentials, message: {}", ec.message());
+        }
+        array<char, 64> buffer;
+        auto read = co_await network::async_read_with_credentials(sock, buffer);
+        if (cred && read && read->sender) {
+            fmt::print("{} bytes from pid {} uid {}, sent by pid {}: {}\n", read->bytes, cred->pid, cred->uid, read->sender->pid, string_view(buffer.data(), read->bytes));
+        }
+    });
+    auto client = async_client(addr);
+
+    auto stop = []() -> task<> {
+        co_await async_sleep(100ms);
+        ::exit(0);
+    }();
+    default_scheduler().run();
+}
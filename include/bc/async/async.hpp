@@ -3,8 +3,13 @@
 #ifndef __BC_ASYNC_H__
 #define __BC_ASYNC_H__
 
+#include "fd_stream.hpp"
+#include "file.hpp"
+#include "process.hpp"
+#include "reactor.hpp"
 #include "scheduler.hpp"
 #include "sleep.hpp"
 #include "task.hpp"
+#include "trace.hpp"
 
 #endif /* __BC_ASYNC_H__ */
@@ -0,0 +1,247 @@
+#pragma once
+
+#ifndef __BC_ASYNC_FD_STREAM_H__
+#define __BC_ASYNC_FD_STREAM_H__
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#include <cassert>
+#include <cerrno>
+#include <coroutine>
+#include <cstddef>
+#include <cstring>
+#include <span>
+#include <system_error>
+#include <utility>
+
+#include <bc/utils/error.hpp>
+#include <bc/utils/expected.hpp>
+#include <bc/utils/noncopyable.hpp>
+#include <bc/log/log.hpp>
+
+#include "scheduler.hpp"
+#include "trace.hpp"
+
+namespace bc::async {
+
+/*
+ * Owning handle for any pollable descriptor that is not a socket: pipes,
+ * FIFOs, eventfd, timerfd, signalfd, inotify, ttys. The descriptor is switched
+ * to non-blocking mode and registered with the default scheduler on demand.
+ */
+class fd_stream : private utils::noncopyable {
+public:
+    static auto wrap(int fd) -> fd_stream {
+        auto flags = ::fcntl(fd, F_GETFL);
+        if (flags == -1 || ::fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1) {
+            log::error("failed to set non-blocking mode, fd: {}, errno: {}, message: {}", fd, errno, ::strerror(errno));
+            throw utils::trans_error_code(errno);
+        }
+        fd_stream stream;
+        stream.fd_ = fd;
+        return stream;
+    }
+
+    /*
+     * Returns the read end and the write end.
+     */
+    static auto pipe() -> std::pair<fd_stream, fd_stream> {
+        int fds[2];
+        if (::pipe2(fds, O_NONBLOCK | O_CLOEXEC) == -1) {
+            log::error("failed to create pipe, errno: {}, message: {}", errno, ::strerror(errno));
+            throw utils::trans_error_code(errno);
+        }
+        fd_stream r, w;
+        r.fd_ = fds[0];
+        w.fd_ = fds[1];
+        return {std::move(r), std::move(w)};
+    }
+
+public:
+    fd_stream() = default;
+    fd_stream(fd_stream &&other) : fd_(std::exchange(other.fd_, -1)) {}
+    auto operator=(fd_stream &&other) -> fd_stream & {
+        if (this != &other) {
+            close();
+            fd_ = std::exchange(other.fd_, -1);
+        }
+        return *this;
+    }
+    ~fd_stream() {
+        close();
+    }
+
+    auto close() -> void {
+        if (fd_ != -1) {
+            default_scheduler().unsubscribe(fd_);
+            if (::close(fd_) == -1) {
+                log::error("failed to close fd, fd: {}, errno: {}, message: {}", fd_, errno, ::strerror(errno));
+            }
+            fd_ = -1;
+        }
+    }
+
+    auto release() -> int {
+        if (fd_ != -1) {
+            default_scheduler().unsubscribe(fd_);
+        }
+        return std::exchange(fd_, -1);
+    }
+
+    /*
+     * Non-blocking; reports resource_unavailable_try_again when nothing is
+     * ready and 0 at end of file.
+     */
+    auto read(std::span<char> buffer) -> utils::expected<std::size_t, std::error_code> {
+        while (true) {
+            auto res = ::read(fd_, buffer.data(), buffer.size());
+            if (res == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno != EAGAIN) {
+                    log::error("failed to read, fd: {}, errno: {}, message: {}", fd_, errno, ::strerror(errno));
+                }
+                return utils::trans_error_code(errno);
+            }
+            return res;
+        }
+    }
+
+    /*
+     * Non-blocking; reports resource_unavailable_try_again when the pipe is
+     * full. Never raises SIGPIPE: a write to a pipe without readers reports
+     * broken_pipe instead of killing the process.
+     */
+    auto write(std::span<char const> data) -> utils::expected<std::size_t, std::error_code> {
+        sigset_t pipe, pending, old;
+        ::sigemptyset(&pipe);
+        ::sigaddset(&pipe, SIGPIPE);
+        ::sigpending(&pending);
+        // A SIGPIPE already pending for this thread is not ours to consume.
+        auto was_pending = ::sigismember(&pending, SIGPIPE) == 1;
+        ::pthread_sigmask(SIG_BLOCK, &pipe, &old);
+        ssize_t res;
+        while ((res = ::write(fd_, data.data(), data.size())) == -1 && errno == EINTR) {}
+        auto error = errno;
+        if (res == -1 && error == EPIPE && !was_pending) {
+            timespec zero {};
+            while (::sigtimedwait(&pipe, nullptr, &zero) == -1 && errno == EINTR) {}
+        }
+        ::pthread_sigmask(SIG_SETMASK, &old, nullptr);
+        if (res == -1) {
+            if (error != EAGAIN && error != EPIPE) {
+                log::error("failed to write, fd: {}, errno: {}, message: {}", fd_, error, ::strerror(error));
+            }
+            return utils::trans_error_code(error);
+        }
+        return res;
+    }
+
+    auto descriptor() const -> int { return fd_; }
+
+private:
+    int fd_ {-1};
+};
+
+namespace detail {
+
+/*
+ * Tries the operation first and suspends only on would-block; the retry then
+ * runs from a scheduler proxy on every readiness event and resumes the
+ * coroutine once it stops reporting would-block.
+ */
+template <typename Op>
+class fd_io_awaiter {
+public:
+    fd_io_awaiter(fd_stream &stream, event e, char const *name, Op op) : stream_(stream), e_(e), name_(name), op_(std::move(op)) {}
+
+    auto await_ready() -> bool {
+        res_ = op_(stream_);
+        return res_ || !utils::would_block(res_.error());
+    }
+
+    auto await_suspend(std::coroutine_handle<> handle) noexcept {
+        trace::instant(name_, stream_.descriptor(), handle.address());
+        default_scheduler().post_coro(stream_.descriptor(), e_ | ERROR | HANGUP, revent_, [this, next=handle] {
+            auto res = op_(stream_);
+            if (!res && utils::would_block(res.error())) {
+                return false;
+            }
+            res_ = std::move(res);
+            next.resume();
+            return true;
+        });
+        return true;
+    }
+
+    auto await_resume() noexcept -> utils::expected<std::size_t, std::error_code> {
+        log::debug("fd io awaiter resume, fd: {}, revent: {}", stream_.descriptor(), revent_);
+        return std::move(res_);
+    }
+
+private:
+    fd_stream &stream_;
+    event e_;
+    char const *name_;
+    Op op_;
+    event revent_ {NONE};
+    utils::expected<std::size_t, std::error_code> res_;
+};
+
+class fd_wait_awaiter {
+public:
+    fd_wait_awaiter(fd_stream &stream, event e) : stream_(stream), e_(e) {}
+
+    auto await_ready() -> bool {
+        return false;
+    }
+
+    auto await_suspend(std::coroutine_handle<> handle) noexcept {
+        trace::instant("suspend_fd_wait", stream_.descriptor(), handle.address());
+        default_scheduler().post_coro(stream_.descriptor(), e_, revent_, handle);
+        return true;
+    }
+
+    auto await_resume() noexcept -> event {
+        return revent_;
+    }
+
+private:
+    fd_stream &stream_;
+    event e_;
+    event revent_ {NONE};
+};
+
+} /* namespace bc::async::detail */
+
+inline auto async_read(fd_stream &stream, std::span<char> buffer) {
+    return detail::fd_io_awaiter(stream, READ, "suspend_fd_read", [buffer](fd_stream &stream) {
+        return stream.read(buffer);
+    });
+}
+
+inline auto async_write(fd_stream &stream, std::span<char const> data) {
+    return detail::fd_io_awaiter(stream, WRITE, "suspend_fd_write", [data](fd_stream &stream) -> utils::expected<std::size_t, std::error_code> {
+        auto res = stream.write(data);
+        if (!res && res.error() == utils::trans_error_code(EPIPE)) {
+            return utils::trans_error_code(utils::detail::closed_by_peer);
+        }
+        return res;
+    });
+}
+
+/*
+ * Resumes with the events that fired, for descriptors whose payload is not a
+ * byte stream (inotify, signalfd) or when only readiness matters; CANCELED
+ * when the scheduler cancelled the descriptor's waiters.
+ */
+inline auto async_wait(fd_stream &stream, event e) -> detail::fd_wait_awaiter {
+    return {stream, e};
+}
+
+} /* namespace bc::async */
+
+#endif /* __BC_ASYNC_FD_STREAM_H__ */
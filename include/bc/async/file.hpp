@@ -0,0 +1,271 @@
+#pragma once
+
+#ifndef __BC_ASYNC_FILE_H__
+#define __BC_ASYNC_FILE_H__
+
+#include <fcntl.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <cassert>
+#include <cerrno>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <span>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <bc/utils/error.hpp>
+#include <bc/utils/expected.hpp>
+#include <bc/utils/noncopyable.hpp>
+#include <bc/log/log.hpp>
+
+#include "scheduler.hpp"
+#include "trace.hpp"
+
+namespace bc::async {
+
+enum class file_backend {
+    IO_URING,
+    THREAD_POOL,
+};
+
+/*
+ * Selects how the calling thread performs file I/O. Only honoured before its
+ * first file operation; by default io_uring is used when the kernel allows it.
+ */
+auto set_file_backend(file_backend backend) -> void;
+auto current_file_backend() -> file_backend;
+
+namespace detail {
+
+struct file_op {
+    enum class kind {
+        READ,
+        WRITE,
+        FSYNC,
+        FDATASYNC,
+    };
+
+    kind kind;
+    int fd;
+    std::uint64_t offset {0};
+    void *data {nullptr};
+    std::size_t size {0};
+    ssize_t result {0};
+    std::size_t *pending {nullptr};
+    std::coroutine_handle<> next {};
+};
+
+/*
+ * Queues the operations on the calling thread's I/O engine. Each completion
+ * decrements *op.pending and the op whose decrement reaches zero resumes its
+ * coroutine on the calling thread's scheduler.
+ */
+auto submit_file_ops(std::span<file_op> ops) -> void;
+
+/*
+ * Runs the operation inline, used when the scheduler runs on a virtual clock
+ * and no completion would ever be delivered.
+ */
+auto perform_file_op(file_op &op) -> void;
+
+inline auto file_op_result(file_op const &op) -> utils::expected<std::size_t, std::error_code> {
+    if (op.result < 0) {
+        return utils::trans_error_code(-op.result);
+    }
+    return static_cast<std::size_t>(op.result);
+}
+
+class file_awaiter {
+public:
+    file_awaiter(file_op op) : op_(op) {}
+
+    auto await_ready() -> bool {
+        if (default_scheduler().is_virtual()) {
+            perform_file_op(op_);
+            return true;
+        }
+        return false;
+    }
+
+    auto await_suspend(std::coroutine_handle<> handle) noexcept {
+        trace::instant("suspend_file", op_.fd, handle.address(), "offset", op_.offset);
+        pending_ = 1;
+        op_.pending = &pending_;
+        op_.next = handle;
+        submit_file_ops({&op_, 1});
+        return true;
+    }
+
+    auto await_resume() noexcept -> utils::expected<std::size_t, std::error_code> {
+        return file_op_result(op_);
+    }
+
+private:
+    file_op op_;
+    std::size_t pending_ {0};
+};
+
+} /* namespace bc::async::detail */
+
+/*
+ * A regular file read and written at explicit offsets without blocking the
+ * reactor. Opened with O_DIRECT, buffers, offsets and sizes must be aligned to
+ * s_direct_alignment; aligned_buffer() allocates suitable memory.
+ */
+class file : private utils::noncopyable {
+public:
+    constexpr static std::size_t s_direct_alignment = 4096;
+
+    static auto open(std::string const &path, int flags, mode_t mode = 0644) -> utils::expected<file, std::error_code> {
+        int fd = ::open(path.c_str(), flags | O_CLOEXEC, mode);
+        if (fd == -1) {
+            log::error("failed to open file {}, errno: {}, message: {}", path, errno, ::strerror(errno));
+            return utils::trans_error_code(errno);
+        }
+        file f;
+        f.fd_ = fd;
+        return f;
+    }
+
+    static auto aligned_buffer(std::size_t size) -> std::unique_ptr<char[], decltype(&std::free)> {
+        auto rounded = (size + s_direct_alignment - 1) / s_direct_alignment * s_direct_alignment;
+        return {static_cast<char *>(std::aligned_alloc(s_direct_alignment, rounded)), &std::free};
+    }
+
+public:
+    file() = default;
+    file(file &&other) : fd_(std::exchange(other.fd_, -1)) {}
+    auto operator=(file &&other) -> file & {
+        if (this != &other) {
+            close();
+            fd_ = std::exchange(other.fd_, -1);
+        }
+        return *this;
+    }
+    ~file() {
+        close();
+    }
+
+    auto close() -> void {
+        if (fd_ != -1 && ::close(fd_) == -1) {
+            log::error("failed to close file, fd: {}, errno: {}, message: {}", fd_, errno, ::strerror(errno));
+        }
+        fd_ = -1;
+    }
+
+    auto read_at(std::uint64_t offset, std::span<char> buffer) -> detail::file_awaiter {
+        return detail::file_op {
+            .kind = detail::file_op::kind::READ,
+            .fd = fd_,
+            .offset = offset,
+            .data = buffer.data(),
+            .size = buffer.size(),
+        };
+    }
+
+    auto write_at(std::uint64_t offset, std::span<char const> data) -> detail::file_awaiter {
+        return detail::file_op {
+            .kind = detail::file_op::kind::WRITE,
+            .fd = fd_,
+            .offset = offset,
+            .data = const_cast<char *>(data.data()),
+            .size = data.size(),
+        };
+    }
+
+    auto fsync() -> detail::file_awaiter {
+        return detail::file_op {.kind = detail::file_op::kind::FSYNC, .fd = fd_};
+    }
+
+    auto fdatasync() -> detail::file_awaiter {
+        return detail::file_op {.kind = detail::file_op::kind::FDATASYNC, .fd = fd_};
+    }
+
+    auto descriptor() const -> int { return fd_; }
+
+private:
+    int fd_ {-1};
+};
+
+/*
+ * Collects operations and submits them together: one io_uring_enter per
+ * ring's worth, or one hand-off to the I/O threads. co_await submit() resumes
+ * once all of them have completed, with results in the order they were added.
+ */
+class file_batch : private utils::noncopyable {
+    class submit_awaiter {
+    public:
+        submit_awaiter(file_batch &batch) : batch_(batch) {}
+
+        auto await_ready() -> bool {
+            if (batch_.ops_.empty()) {
+                return true;
+            }
+            if (default_scheduler().is_virtual()) {
+                for (auto &op : batch_.ops_) {
+                    detail::perform_file_op(op);
+                }
+                return true;
+            }
+            return false;
+        }
+
+        auto await_suspend(std::coroutine_handle<> handle) noexcept {
+            trace::instant("suspend_file_batch", -1, handle.address(), "ops", batch_.ops_.size());
+            batch_.pending_ = batch_.ops_.size();
+            for (auto &op : batch_.ops_) {
+                op.pending = &batch_.pending_;
+                op.next = handle;
+            }
+            detail::submit_file_ops(batch_.ops_);
+            return true;
+        }
+
+        auto await_resume() -> std::vector<utils::expected<std::size_t, std::error_code>> {
+            std::vector<utils::expected<std::size_t, std::error_code>> results;
+            results.reserve(batch_.ops_.size());
+            for (auto const &op : batch_.ops_) {
+                results.push_back(detail::file_op_result(op));
+            }
+            batch_.ops_.clear();
+            return results;
+        }
+
+    private:
+        file_batch &batch_;
+    };
+
+public:
+    auto read_at(file &f, std::uint64_t offset, std::span<char> buffer) -> void {
+        ops_.push_back({.kind = detail::file_op::kind::READ, .fd = f.descriptor(), .offset = offset, .data = buffer.data(), .size = buffer.size()});
+    }
+
+    auto write_at(file &f, std::uint64_t offset, std::span<char const> data) -> void {
+        ops_.push_back({.kind = detail::file_op::kind::WRITE, .fd = f.descriptor(), .offset = offset, .data = const_cast<char *>(data.data()), .size = data.size()});
+    }
+
+    auto fsync(file &f) -> void {
+        ops_.push_back({.kind = detail::file_op::kind::FSYNC, .fd = f.descriptor()});
+    }
+
+    auto size() const -> std::size_t { return ops_.size(); }
+
+    auto submit() -> submit_awaiter {
+        return {*this};
+    }
+
+private:
+    std::vector<detail::file_op> ops_;
+    std::size_t pending_ {0};
+};
+
+} /* namespace bc::async */
+
+#endif /* __BC_ASYNC_FILE_H__ */
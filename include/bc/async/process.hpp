@@ -0,0 +1,337 @@
+#pragma once
+
+#ifndef __BC_ASYNC_PROCESS_H__
+#define __BC_ASYNC_PROCESS_H__
+
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <cerrno>
+#include <coroutine>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <bc/utils/error.hpp>
+#include <bc/utils/expected.hpp>
+#include <bc/utils/noncopyable.hpp>
+#include <bc/log/log.hpp>
+
+#include "fd_stream.hpp"
+#include "scheduler.hpp"
+#include "trace.hpp"
+
+#ifndef P_PIDFD
+#define P_PIDFD 3
+#endif
+
+extern char **environ;
+
+namespace bc::async {
+
+struct spawn_options {
+    bool pipe_stdin {true};
+    bool pipe_stdout {true};
+    bool pipe_stderr {false};
+    /* "NAME=value" entries replacing the environment, inherited when empty */
+    std::vector<std::string> env;
+    /* SIGKILL a child still running when its process is destroyed */
+    bool kill_on_destroy {false};
+};
+
+struct exit_status {
+    int code {-1};
+    int signal {0};
+
+    auto success() const -> bool { return signal == 0 && code == 0; }
+};
+
+class process;
+
+namespace detail {
+
+class process_wait_awaiter {
+public:
+    process_wait_awaiter(process &proc) : proc_(proc) {}
+
+    auto await_ready() -> bool;
+    auto await_suspend(std::coroutine_handle<> handle) noexcept -> bool;
+    auto await_resume() -> utils::expected<exit_status, std::error_code>;
+
+private:
+    process &proc_;
+    event revent_ {NONE};
+};
+
+/*
+ * Keeps the pidfd of a child nobody waits for any more registered until the
+ * child exits, then reaps it so it does not linger as a zombie.
+ */
+inline auto reap_orphan(pid_t pid, fd_stream &&pidfd) -> void {
+    struct orphan {
+        pid_t pid;
+        fd_stream pidfd;
+        event revent {NONE};
+    };
+    auto child = std::make_shared<orphan>(pid, std::move(pidfd));
+    default_scheduler().post_coro(child->pidfd.descriptor(), READ, child->revent, [child] {
+        if (child->revent & CANCELED) {
+            return true;
+        }
+        siginfo_t info {};
+        while (::waitid(static_cast<idtype_t>(P_PIDFD), child->pidfd.descriptor(), &info, WEXITED | WNOHANG) == -1) {
+            if (errno != EINTR) {
+                log::error("failed to reap process, pid: {}, errno: {}, message: {}", child->pid, errno, ::strerror(errno));
+                return true;
+            }
+        }
+        return info.si_pid != 0;
+    });
+}
+
+} /* namespace bc::async::detail */
+
+/*
+ * A child started with posix_spawn, which glibc implements with
+ * clone(CLONE_VM | CLONE_VFORK) so launching does not copy the parent's page
+ * tables. Exit is observed through a pidfd registered with the scheduler, so
+ * no thread ever blocks in waitpid. A child still running when its process is
+ * destroyed is reaped by the scheduler once it exits, which like any other
+ * wait keeps run() going until then; kill_on_destroy ends it right away.
+ */
+class process : private utils::noncopyable {
+    friend class detail::process_wait_awaiter;
+
+public:
+    static auto spawn(std::vector<std::string> const &argv, spawn_options const &options = {}) -> utils::expected<process, std::error_code> {
+        if (argv.empty()) {
+            return utils::trans_error_code(EINVAL);
+        }
+        std::vector<char *> args;
+        for (auto const &arg : argv) {
+            args.push_back(const_cast<char *>(arg.c_str()));
+        }
+        args.push_back(nullptr);
+        std::vector<char *> envs;
+        for (auto const &env : options.env) {
+            envs.push_back(const_cast<char *>(env.c_str()));
+        }
+        envs.push_back(nullptr);
+
+        process proc;
+        std::vector<int> child_ends;
+        posix_spawn_file_actions_t actions;
+        ::posix_spawn_file_actions_init(&actions);
+        auto redirect = [&](bool enabled, int target, fd_stream &parent) -> int {
+            if (!enabled) {
+                return 0;
+            }
+            int fds[2];
+            if (::pipe2(fds, O_CLOEXEC) == -1) {
+                return errno;
+            }
+            /* the child end keeps blocking semantics, which most programs expect */
+            auto [child, ours] = target == STDIN_FILENO ? std::pair(fds[0], fds[1]) : std::pair(fds[1], fds[0]);
+            parent = fd_stream::wrap(ours);
+            ::posix_spawn_file_actions_adddup2(&actions, child, target);
+            child_ends.push_back(child);
+            return 0;
+        };
+        int error = redirect(options.pipe_stdin, STDIN_FILENO, proc.in_);
+        if (!error) {
+            error = redirect(options.pipe_stdout, STDOUT_FILENO, proc.out_);
+        }
+        if (!error) {
+            error = redirect(options.pipe_stderr, STDERR_FILENO, proc.err_);
+        }
+
+        posix_spawnattr_t attr;
+        ::posix_spawnattr_init(&attr);
+        sigset_t mask;
+        sigemptyset(&mask);
+        ::posix_spawnattr_setsigmask(&attr, &mask);
+        ::posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK);
+
+        if (!error) {
+            error = ::posix_spawnp(&proc.pid_, args[0], &actions, &attr, args.data(), options.env.empty() ? environ : envs.data());
+        }
+        ::posix_spawnattr_destroy(&attr);
+        ::posix_spawn_file_actions_destroy(&actions);
+        for (auto fd : child_ends) {
+            ::close(fd);
+        }
+        if (error) {
+            log::error("failed to spawn {}, errno: {}, message: {}", argv[0], error, ::strerror(error));
+            proc.pid_ = -1;
+            return utils::trans_error_code(error);
+        }
+
+        int pidfd = ::syscall(SYS_pidfd_open, proc.pid_, 0);
+        if (pidfd == -1) {
+            log::error("failed to open pidfd, pid: {}, errno: {}, message: {}", proc.pid_, errno, ::strerror(errno));
+            auto ec = utils::trans_error_code(errno);
+            ::kill(proc.pid_, SIGKILL);
+            ::waitpid(proc.pid_, nullptr, 0);
+            proc.pid_ = -1;
+            return ec;
+        }
+        proc.pidfd_ = fd_stream::wrap(pidfd);
+        proc.kill_on_destroy_ = options.kill_on_destroy;
+        return proc;
+    }
+
+public:
+    process() = default;
+    process(process &&other)
+        : pid_(std::exchange(other.pid_, -1)), pidfd_(std::move(other.pidfd_)), in_(std::move(other.in_)),
+          out_(std::move(other.out_)), err_(std::move(other.err_)), status_(std::move(other.status_)),
+          kill_on_destroy_(other.kill_on_destroy_) {}
+    auto operator=(process &&other) -> process & {
+        if (this != &other) {
+            release_();
+            pid_ = std::exchange(other.pid_, -1);
+            pidfd_ = std::move(other.pidfd_);
+            in_ = std::move(other.in_);
+            out_ = std::move(other.out_);
+            err_ = std::move(other.err_);
+            status_ = std::move(other.status_);
+            kill_on_destroy_ = other.kill_on_destroy_;
+        }
+        return *this;
+    }
+    ~process() {
+        release_();
+    }
+
+    auto pid() const -> pid_t { return pid_; }
+
+    /*
+     * Parent ends of the redirected standard streams; empty streams for the
+     * ones spawn_options left inherited.
+     */
+    auto in() -> fd_stream & { return in_; }
+    auto out() -> fd_stream & { return out_; }
+    auto err() -> fd_stream & { return err_; }
+
+    /*
+     * Signals through the pidfd, so a recycled pid can never be hit.
+     */
+    auto kill(int signal = SIGTERM) -> std::error_code {
+        if (::syscall(SYS_pidfd_send_signal, pidfd_.descriptor(), signal, nullptr, 0) == -1) {
+            log::error("failed to signal process, pid: {}, errno: {}, message: {}", pid_, errno, ::strerror(errno));
+            return utils::trans_error_code(errno);
+        }
+        return {};
+    }
+
+    /*
+     * Reaps the child if it has exited, without blocking.
+     */
+    auto try_wait() -> std::optional<exit_status> {
+        if (status_) {
+            return status_;
+        }
+        siginfo_t info {};
+        while (::waitid(static_cast<idtype_t>(P_PIDFD), pidfd_.descriptor(), &info, WEXITED | WNOHANG) == -1) {
+            if (errno != EINTR) {
+                log::error("failed to wait process, pid: {}, errno: {}, message: {}", pid_, errno, ::strerror(errno));
+                return std::nullopt;
+            }
+        }
+        if (info.si_pid == 0) {
+            return std::nullopt;
+        }
+        if (info.si_code == CLD_EXITED) {
+            status_ = exit_status {.code = info.si_status};
+        }
+        else {
+            status_ = exit_status {.signal = info.si_status};
+        }
+        return status_;
+    }
+
+    auto async_wait() -> detail::process_wait_awaiter {
+        return {*this};
+    }
+
+private:
+    auto release_() -> void {
+        if (pidfd_.descriptor() == -1 || status_ || try_wait()) {
+            return;
+        }
+        if (kill_on_destroy_) {
+            kill(SIGKILL);
+        }
+        detail::reap_orphan(pid_, std::move(pidfd_));
+    }
+
+private:
+    pid_t pid_ {-1};
+    fd_stream pidfd_;
+    fd_stream in_;
+    fd_stream out_;
+    fd_stream err_;
+    std::optional<exit_status> status_;
+    bool kill_on_destroy_ {false};
+};
+
+namespace detail {
+
+inline auto process_wait_awaiter::await_ready() -> bool {
+    return proc_.try_wait().has_value();
+}
+
+inline auto process_wait_awaiter::await_suspend(std::coroutine_handle<> handle) noexcept -> bool {
+    trace::instant("suspend_process_wait", proc_.pidfd_.descriptor(), handle.address(), "pid", proc_.pid_);
+    default_scheduler().post_coro(proc_.pidfd_.descriptor(), READ, revent_, handle);
+    return true;
+}
+
+inline auto process_wait_awaiter::await_resume() -> utils::expected<exit_status, std::error_code> {
+    if (auto status = proc_.try_wait()) {
+        return *status;
+    }
+    if (revent_ & CANCELED) {
+        return utils::trans_error_code(utils::detail::operation_canceled);
+    }
+    return utils::trans_error_code(ECHILD);
+}
+
+class spawn_awaiter {
+public:
+    spawn_awaiter(utils::expected<process, std::error_code> &&res) : res_(std::move(res)) {}
+
+    auto await_ready() -> bool {
+        return true;
+    }
+
+    auto await_suspend(std::coroutine_handle<>) noexcept {}
+
+    auto await_resume() -> utils::expected<process, std::error_code> {
+        return std::move(res_);
+    }
+
+private:
+    utils::expected<process, std::error_code> res_;
+};
+
+} /* namespace bc::async::detail */
+
+/*
+ * Launching never suspends; it is awaitable so call sites read like the rest
+ * of the asynchronous API.
+ */
+inline auto spawn_process(std::vector<std::string> const &argv, spawn_options const &options = {}) -> detail::spawn_awaiter {
+    return {process::spawn(argv, options)};
+}
+
+} /* namespace bc::async */
+
+#endif /* __BC_ASYNC_PROCESS_H__ */
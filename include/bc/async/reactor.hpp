@@ -0,0 +1,80 @@
+#pragma once
+
+#ifndef __BC_ASYNC_REACTOR_H__
+#define __BC_ASYNC_REACTOR_H__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <bc/utils/noncopyable.hpp>
+
+#include "scheduler.hpp"
+
+namespace bc::async {
+
+enum class load_metric {
+    SESSIONS,
+    LATENCY,
+};
+
+/*
+ * A scheduler running on its own thread. The thread installs the scheduler as
+ * its default one, so coroutines started by posted functions register with it.
+ */
+class reactor : private utils::noncopyable {
+public:
+    explicit reactor(std::vector<int> cpus = {});
+    ~reactor();
+
+    auto post(std::move_only_function<auto () -> void> f) -> void {
+        scheduler_.post(std::move(f));
+    }
+
+    /*
+     * Closes the mailbox; the thread exits once the coroutines already on the
+     * reactor have finished.
+     */
+    auto stop() -> void;
+
+    auto scheduler() -> async::scheduler & { return scheduler_; }
+    auto sessions() -> std::atomic_size_t & { return sessions_; }
+    auto load(load_metric metric) const -> std::uint64_t;
+
+private:
+    auto loop_() -> void;
+
+private:
+    async::scheduler scheduler_;
+    std::atomic_size_t sessions_ {0};
+    std::atomic_bool stopped_ {false};
+    std::jthread thread_;
+};
+
+class reactor_pool : private utils::noncopyable {
+public:
+    explicit reactor_pool(std::size_t count, load_metric metric = load_metric::SESSIONS);
+    /*
+     * One reactor per cpu set, each pinned to its set.
+     */
+    explicit reactor_pool(std::vector<std::vector<int>> const &cpus, load_metric metric = load_metric::SESSIONS);
+
+    auto size() const -> std::size_t { return reactors_.size(); }
+    auto operator[](std::size_t index) -> reactor & { return *reactors_[index]; }
+
+    auto least_loaded() const -> std::size_t;
+    auto stop() -> void;
+
+private:
+    load_metric metric_;
+    std::vector<std::unique_ptr<reactor>> reactors_;
+    mutable std::atomic_size_t next_ {0};
+};
+
+} /* namespace bc::async */
+
+#endif /* __BC_ASYNC_REACTOR_H__ */
@@ -4,8 +4,12 @@
 #define __BC_ASYNC_SCHEDULER_H__
 
 #include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/types.h>
+#include <unistd.h>
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <bit>
 #include <cassert>
 #include <cerrno>
@@ -16,7 +20,10 @@
 #include <cstring>
 #include <functional>
 #include <list>
+#include <map>
+#include <mutex>
 #include <queue>
+#include <random>
 #include <ranges>
 #include <set>
 #include <system_error>
@@ -24,10 +31,14 @@
 #include <variant>
 #include <vector>
 
+#include <bc/utils/affinity.hpp>
 #include <bc/utils/error.hpp>
+#include <bc/utils/memory.hpp>
 #include <bc/utils/noncopyable.hpp>
 #include <bc/log/log.hpp>
 
+#include "trace.hpp"
+
 namespace bc::network {
 
 enum class protocol;
@@ -35,10 +46,14 @@ enum class protocol;
 template <protocol>
 class socket;
 
+class shm_stream;
+
 }
 
 namespace bc::async {
 
+class fd_stream;
+
 using event = u_int32_t;
 
 constexpr event NONE = 0;
@@ -47,6 +62,10 @@ constexpr event WRITE = EPOLLOUT;
 constexpr event ERROR = EPOLLERR;
 constexpr event HANGUP = EPOLLHUP;
 constexpr event RDHANGUP = EPOLLRDHUP;
+/* wake only one of the epoll instances waiting on the fd; never reported */
+constexpr event EXCLUSIVE = EPOLLEXCLUSIVE;
+/* not an epoll event: reported by scheduler::cancel() alone */
+constexpr event CANCELED = 1u << 27;
 
 class poller {
 public:
@@ -75,7 +94,12 @@ public:
         if (timeout < 0) {
             return;
         }
-        auto nfds = ::epoll_wait(epfd_, evs_.data(), evs_.size(), timeout);
+        auto nfds = [&] {
+            trace::span span("epoll_wait");
+            auto nfds = ::epoll_wait(epfd_, evs_.data(), evs_.size(), timeout);
+            span.set_arg("nfds", nfds);
+            return nfds;
+        }();
         if (nfds == -1) {
             if (errno == EINTR) {
                 log::info("epoll_wait was interrupted");
@@ -84,7 +108,9 @@ public:
             log::error("epoll_wait failed, errno: {}, message: {}", errno, ::strerror(errno));
             throw utils::trans_error_code(errno);
         }
-        for (auto &ev : evs_ | std::ranges::views::take(nfds)) {
+        // handlers may subscribe new fds and grow evs_, so index and copy
+        for (int i = 0; i < nfds; ++i) {
+            auto ev = evs_[i];
             log::debug("got epoll event, fd: {}, event: {}", static_cast<int>(ev.data.fd), static_cast<int>(ev.events));
             handler(ev.data.fd, static_cast<event>(ev.events));
         }
@@ -95,7 +121,7 @@ private:
         if (focus_.size() > index) {
             return;
         }
-        auto need = std::bit_ceil(index);
+        auto need = std::bit_ceil(index + 1);
         log::debug("poller adjust size to {}", need);
         focus_.resize(need);
         evs_.resize(need, {
@@ -112,13 +138,77 @@ private:
     std::vector<epoll_event> evs_;
 };
 
+/*
+ * In-process stand-in for poller used by virtual-clock schedulers: nothing
+ * reaches the kernel, readiness only comes from inject(). Events injected for
+ * the same fd are merged like epoll would, and each poll delivers the ready
+ * ones in an order shuffled by the seeded engine, so a run is reproducible
+ * from its seed.
+ */
+class fake_poller {
+public:
+    explicit fake_poller(std::uint64_t seed) : engine_(seed) {}
+
+    auto subscribe(int fd, event e) -> void;
+
+    auto unsubscribe(int fd) -> void {
+        subscribe(fd, NONE);
+    }
+
+    auto inject(int fd, event e) -> void;
+    auto deliverable() const -> bool;
+
+    template <typename Rep, typename Period, typename EventHandler>
+    auto poll(std::chrono::duration<Rep, Period>, EventHandler &&handler) -> void {
+        std::vector<std::pair<int, event>> ready;
+        auto it = pending_.begin();
+        while (it != pending_.end()) {
+            if (auto e = matched_(it->first, it->second)) {
+                ready.emplace_back(it->first, e);
+                pending_.erase(it++);
+            }
+            else {
+                ++it;
+            }
+        }
+        std::ranges::shuffle(ready, engine_);
+        for (auto [fd, e] : ready) {
+            log::debug("got fake event, fd: {}, event: {}", fd, e);
+            handler(fd, e);
+        }
+    }
+
+private:
+    auto matched_(int fd, event e) const -> event {
+        if (static_cast<std::size_t>(fd) >= focus_.size() || focus_[fd] == NONE) {
+            return NONE;
+        }
+        return e & (focus_[fd] | ERROR | HANGUP);
+    }
+
+private:
+    std::vector<event> focus_;
+    std::map<int, event> pending_;
+    std::mt19937_64 engine_;
+};
+
+struct virtual_clock_t {
+    explicit virtual_clock_t() = default;
+};
+
+inline constexpr virtual_clock_t virtual_clock {};
+
 class scheduler : utils::noncopyable {
     template <network::protocol>
     friend class network::socket;
+    friend class network::shm_stream;
+    friend class fd_stream;
 
+public:
     using time_point = decltype(std::chrono::steady_clock::now());
     using duration = time_point::duration;
 
+private:
     struct time_node {
         time_point time;
         std::coroutine_handle<> next;
@@ -134,11 +224,85 @@ class scheduler : utils::noncopyable {
         std::variant<std::coroutine_handle<>, std::function<auto () -> bool>> next;
     };
 
+    template <typename T>
+    using allocator = utils::memory::allocator<T, utils::memory::category::SCHEDULER>;
+    using descriptor_list = std::list<descriptor_node, allocator<descriptor_node>>;
+
 public:
     constexpr static auto s_period = std::chrono::seconds(1);
 
+    struct statistics {
+        utils::placement placement;
+        std::size_t coroutines;
+        std::size_t timers;
+        /* process-wide, indexed by utils::memory::category */
+        std::array<utils::memory::usage, std::to_underlying(utils::memory::category::COUNT)> memory;
+    };
+
 public:
-    auto run() -> void;
+    scheduler() : poller_(std::in_place_type<poller>) {}
+    /*
+     * Simulation mode: time only advances by jumping to the next time node and
+     * descriptor readiness comes from inject(), so hours of timers run in
+     * milliseconds and the same seed replays the same interleaving.
+     */
+    explicit scheduler(virtual_clock_t, std::uint64_t seed = 0)
+        : virtual_(true), engine_(seed), poller_(std::in_place_type<fake_poller>, seed) {}
+    ~scheduler() noexcept;
+
+    auto run() -> void {
+        run_until(time_point::max());
+    }
+    auto run_until(time_point deadline) -> void;
+    template <typename Rep, typename Period>
+    auto run_for(std::chrono::duration<Rep, Period> rtime) -> void {
+        run_until(now() + std::chrono::duration_cast<duration>(rtime));
+    }
+
+    auto now() const -> time_point {
+        return virtual_ ? virtual_now_ : std::chrono::steady_clock::now();
+    }
+    auto is_virtual() const -> bool { return virtual_; }
+    auto random() -> std::mt19937_64 & { return engine_; }
+    auto inject(int fd, event e) -> void {
+        assert(virtual_);
+        std::get<fake_poller>(poller_).inject(fd, e);
+    }
+
+    /*
+     * Pins the thread that runs this scheduler to the given cpus the next time
+     * run_until() starts, and makes it prefer memory from their NUMA node so
+     * the tables it grows while running stay local.
+     */
+    auto set_affinity(std::vector<int> cpus) -> void {
+        cpus_ = std::move(cpus);
+        pinned_ = false;
+    }
+    auto stats() const -> statistics {
+        return {placement_, coro_count_, time_nodes_.size(), utils::memory::snapshot()};
+    }
+
+    /*
+     * The mailbox lets other threads hand work to this scheduler. It is opened
+     * by the thread that runs the scheduler and, while open, keeps run() from
+     * returning. post() and close_mailbox() may be called from any thread;
+     * posted functions run on the scheduler's thread in posting order.
+     */
+    auto open_mailbox() -> void;
+    auto post(std::move_only_function<auto () -> void> f) -> void;
+    auto close_mailbox() -> void {
+        post([this] {
+            mailbox_closed_ = true;
+        });
+    }
+
+    /*
+     * Moving average of the time one loop iteration spends running ready
+     * coroutines, readable from any thread.
+     */
+    auto load() const -> std::chrono::nanoseconds {
+        return std::chrono::nanoseconds(load_.load(std::memory_order_relaxed));
+    }
 
     template <typename Duration>
     auto post_coro(std::chrono::time_point<std::chrono::steady_clock, Duration> tp, std::coroutine_handle<> coro) -> void {
@@ -156,33 +320,58 @@ public:
         ++coro_count_;
     }
 
+    /*
+     * Wakes every coroutine waiting on fd with CANCELED before returning.
+     * A coroutine posted by handle is resumed and finds CANCELED in its
+     * revent; a proxy runs with it, and one that returns false, not knowing
+     * the event, stays registered as if nothing had fired. Once nobody
+     * waits, fd leaves the poller, so it can be closed or passed to another
+     * process without epoll still watching the socket behind it.
+     */
+    auto cancel(int fd) -> void;
+
 private:
     auto adjust_size_(size_t index) -> void {
         if (descriptor_nodes_.size() > index) {
             return;
         }
-        auto need = std::bit_ceil(index);
+        auto need = std::bit_ceil(index + 1);
         log::debug("scheduler adjust size to {}", need);
         descriptor_nodes_.resize(need);
     }
 
     auto update_descriptor_(int fd) -> void;
     auto handle_expired_time_nodes_() -> bool;
+    auto advance_virtual_(time_point deadline) -> bool;
+    auto place_() -> void;
+    auto drain_mailbox_() -> bool;
+    auto record_busy_(duration busy) -> void {
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(busy).count();
+        load_.store((load_.load(std::memory_order_relaxed) * 7 + ns) / 8, std::memory_order_relaxed);
+    }
 
     template <typename Rep, typename Period>
     auto handle_triggered_descriptor_nodes_(std::chrono::duration<Rep, Period> rtime) -> void {
+        time_point first {};
         auto handler = [&](int fd, event e) {
-            std::list<descriptor_node> list;
+            if (first == time_point {}) {
+                first = std::chrono::steady_clock::now();
+            }
+            descriptor_list list;
             list.splice(list.end(), descriptor_nodes_[fd]);
             auto it = list.begin();
             log::debug("coroutines of fd before resume: {}, count: {}", fd, list.size());
             while (it != list.end()) {
                 if (it->ev & e) {
                     it->revent = e;
-                    bool ready = std::visit(utils::overload([](std::coroutine_handle<> handle) {
+                    bool ready = std::visit(utils::overload([&](std::coroutine_handle<> handle) {
+                        trace::span span("resume", fd, handle.address());
+                        span.set_arg("revent", e);
                         handle.resume();
                         return true;
-                    }, [](auto &proxy) {
+                    }, [&](auto &proxy) {
+                        trace::span span("proxy", fd);
+                        span.set_arg("revent", e);
                         return proxy();
                     }), it->next);
                     log::debug("resume coroutine / proxy, fd: {}, events: {}, revent: {}, finished: {}", fd, it->ev, e, ready);
@@ -190,6 +379,9 @@ private:
                         list.erase(it++);
                         --coro_count_;
                     }
+                    else {
+                        ++it;
+                    }
                 }
                 else {
                     ++it;
@@ -199,25 +391,52 @@ private:
             log::debug("coroutines of fd after resume: {}, count: {}", fd, descriptor_nodes_[fd].size());
             update_descriptor_(fd);
         };
-        poller_.poll(rtime, handler);
+        std::visit([&](auto &poller) {
+            poller.poll(rtime, handler);
+        }, poller_);
+        if (first != time_point {}) {
+            record_busy_(std::chrono::steady_clock::now() - first);
+        }
     }
 
     auto subscribe(int fd, event e) -> void {
-        poller_.subscribe(fd, e);
+        std::visit([&](auto &poller) {
+            poller.subscribe(fd, e);
+        }, poller_);
     }
 
     auto unsubscribe(int fd) -> void {
-        poller_.unsubscribe(fd);
+        std::visit([&](auto &poller) {
+            poller.unsubscribe(fd);
+        }, poller_);
     }
 
 private:
     size_t coro_count_ {0};
-    std::priority_queue<time_node, std::vector<time_node>, std::greater<time_node>> time_nodes_;
-    std::vector<std::list<descriptor_node>> descriptor_nodes_;
-    poller poller_;
+    bool virtual_ {false};
+    time_point virtual_now_ {};
+    std::mt19937_64 engine_;
+    std::vector<int> cpus_;
+    bool pinned_ {false};
+    utils::placement placement_;
+    std::atomic_int64_t load_ {0};
+    std::mutex mailbox_mutex_;
+    std::vector<std::move_only_function<auto () -> void>> mailbox_;
+    int mailbox_fd_ {-1};
+    bool mailbox_closed_ {false};
+    event mailbox_revent_ {NONE};
+    std::priority_queue<time_node, std::vector<time_node, allocator<time_node>>, std::greater<time_node>> time_nodes_;
+    std::vector<descriptor_list, allocator<descriptor_list>> descriptor_nodes_;
+    std::variant<poller, fake_poller> poller_;
 };
 
+/*
+ * default_scheduler() is what every awaiter posts to. It returns the scheduler
+ * installed for the calling thread, or the process-wide one if none is.
+ */
 auto default_scheduler() -> scheduler &;
+auto set_default_scheduler(scheduler &sched) -> void;
+auto reset_default_scheduler() -> void;
 
 } /* namespace bc::async */
 
@@ -10,6 +10,7 @@
 #include <bc/log/log.hpp>
 
 #include "scheduler.hpp"
+#include "trace.hpp"
 
 namespace bc::async {
 
@@ -20,13 +21,14 @@ class async_sleep_awaiter {
 
 public:
     template <typename Duration>
-    async_sleep_awaiter(Duration period) : tp_(std::chrono::steady_clock::now() + period) {}
+    async_sleep_awaiter(Duration period) : tp_(default_scheduler().now() + period) {}
 
     auto await_ready() -> bool {
-        return std::chrono::steady_clock::now() >= tp_;
+        return default_scheduler().now() >= tp_;
     }
 
     auto await_suspend(std::coroutine_handle<> handle) noexcept {
+        trace::instant("suspend_sleep", -1, handle.address());
         default_scheduler().post_coro(tp_, handle);
         return true;
     }
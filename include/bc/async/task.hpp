@@ -4,16 +4,40 @@
 #define __BC_ASYNC_TASK_H__
 
 #include <coroutine>
+#include <cstddef>
 #include <exception>
+#include <new>
+#include <type_traits>
 
 #include <bc/log/log.hpp>
+#include <bc/utils/memory.hpp>
 
 #include "scheduler.hpp"
 
 namespace bc::async {
 
+namespace detail {
+
+/*
+ * Charges coroutine frames to utils::memory; the compiler picks these
+ * operators up for every task's frame.
+ */
+struct frame_accounting {
+    static auto operator new(std::size_t size) -> void * {
+        utils::memory::add(utils::memory::category::COROUTINE_FRAMES, size);
+        return ::operator new(size);
+    }
+
+    static auto operator delete(void *p, std::size_t size) noexcept -> void {
+        utils::memory::sub(utils::memory::category::COROUTINE_FRAMES, size);
+        ::operator delete(p, size);
+    }
+};
+
+} /* namespace bc::async::detail */
+
 template <typename T = void>
-struct promise {
+struct promise : detail::frame_accounting {
     using coro_handle = std::coroutine_handle<promise>;
 
     struct final_awaiter {
@@ -53,7 +77,7 @@ struct promise {
 };
 
 template <>
-struct promise<void> {
+struct promise<void> : detail::frame_accounting {
     using coro_handle = std::coroutine_handle<promise>;
 
     struct final_awaiter {
@@ -107,7 +131,11 @@ public:
             handle_.promise().prev = handle;
         }
 
-        auto await_resume() noexcept -> void {}
+        auto await_resume() noexcept -> T {
+            if constexpr (!std::is_void_v<T>) {
+                return std::move(handle_.promise().result);
+            }
+        }
 
     private:
         std::coroutine_handle<promise<T>> handle_;
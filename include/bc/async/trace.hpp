@@ -0,0 +1,182 @@
+#pragma once
+
+#ifndef __BC_ASYNC_TRACE_H__
+#define __BC_ASYNC_TRACE_H__
+
+#include <sys/types.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <ostream>
+
+#include <bc/utils/noncopyable.hpp>
+
+/*
+ * Opt-in scheduling tracer. While enabled, the scheduler, the poller and the
+ * awaiters record suspends, resumes, epoll waits, timer fires and epoll_ctl
+ * calls into a buffer owned by the recording thread. Appends never wait; a
+ * full buffer drops records instead of blocking, and counts them. dump()
+ * writes everything recorded so far as Chrome trace_event JSON
+ * (chrome://tracing, Perfetto); clear() starts a new capture, so a long
+ * running process traces in windows rather than only its first records.
+ */
+namespace bc::async::trace {
+
+/* about 3.5 MiB per recording thread */
+constexpr std::size_t s_default_capacity = 1 << 16;
+
+struct record {
+    char const *name;
+    char phase;
+    std::uint64_t ts;
+    std::uint64_t dur;
+    int fd;
+    std::uintptr_t task;
+    char const *arg_name;
+    std::int64_t arg;
+};
+
+namespace detail {
+
+inline std::atomic_bool g_enabled {false};
+inline std::atomic_size_t g_capacity {s_default_capacity};
+
+/*
+ * Storage is allocated by the owning thread on its first record and returned
+ * by release(), which clear() and disable() call from any thread. The busy
+ * flag keeps the two apart: an append that finds it taken drops its record.
+ */
+class buffer : private utils::noncopyable {
+public:
+    explicit buffer(pid_t tid) : tid_(tid) {}
+
+    auto append(record const &r) noexcept -> void {
+        if (busy_.exchange(true, std::memory_order_acquire)) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        if (!records_) {
+            // a span that straddles disable() must not allocate again
+            if (!g_enabled.load(std::memory_order_relaxed)) {
+                busy_.store(false, std::memory_order_release);
+                return;
+            }
+            allocate_();
+        }
+        auto n = size_.load(std::memory_order_relaxed);
+        if (n == capacity_) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+        }
+        else {
+            records_[n] = r;
+            size_.store(n + 1, std::memory_order_release);
+        }
+        busy_.store(false, std::memory_order_release);
+    }
+
+    auto release() noexcept -> void {
+        // an append holds the flag for a few stores at most
+        while (busy_.exchange(true, std::memory_order_acquire)) {}
+        records_.reset();
+        capacity_ = 0;
+        size_.store(0, std::memory_order_relaxed);
+        dropped_.store(0, std::memory_order_relaxed);
+        busy_.store(false, std::memory_order_release);
+    }
+
+    auto tid() const -> pid_t { return tid_; }
+    auto size() const -> std::size_t { return size_.load(std::memory_order_acquire); }
+    auto dropped() const -> std::size_t { return dropped_.load(std::memory_order_relaxed); }
+    auto operator[](std::size_t i) const -> record const & { return records_[i]; }
+
+private:
+    auto allocate_() noexcept -> void {
+        auto capacity = g_capacity.load(std::memory_order_relaxed);
+        try {
+            // left uninitialized: only records below size_ are ever read
+            records_ = std::make_unique_for_overwrite<record[]>(capacity);
+            capacity_ = capacity;
+        }
+        catch (std::bad_alloc const &) {
+            capacity_ = 0;
+        }
+    }
+
+private:
+    pid_t tid_;
+    std::size_t capacity_ {0};
+    std::unique_ptr<record[]> records_;
+    std::atomic_bool busy_ {false};
+    std::atomic_size_t size_ {0};
+    std::atomic_size_t dropped_ {0};
+};
+
+} /* namespace bc::async::trace::detail */
+
+inline auto enabled() noexcept -> bool {
+    return detail::g_enabled.load(std::memory_order_relaxed);
+}
+
+/*
+ * capacity is the number of records each thread may buffer; it applies to
+ * buffers allocated after the call. disable() stops recording and releases
+ * every buffer, so dump() before it to keep what was recorded.
+ */
+auto enable(std::size_t capacity = s_default_capacity) -> void;
+auto disable() -> void;
+
+auto timestamp() noexcept -> std::uint64_t;
+auto emit(record const &r) noexcept -> void;
+
+inline auto instant(char const *name, int fd, void const *task, char const *arg_name = nullptr, std::int64_t arg = 0) noexcept -> void {
+    if (enabled()) {
+        emit({name, 'i', timestamp(), 0, fd, reinterpret_cast<std::uintptr_t>(task), arg_name, arg});
+    }
+}
+
+class span : private utils::noncopyable {
+public:
+    span(char const *name, int fd = -1, void const *task = nullptr) noexcept
+        : name_(name), fd_(fd), task_(reinterpret_cast<std::uintptr_t>(task)) {
+        if (enabled()) {
+            start_ = timestamp();
+        }
+    }
+    ~span() {
+        if (start_) {
+            emit({name_, 'X', start_, timestamp() - start_, fd_, task_, arg_name_, arg_});
+        }
+    }
+
+    auto set_arg(char const *name, std::int64_t value) noexcept -> void {
+        arg_name_ = name;
+        arg_ = value;
+    }
+
+private:
+    char const *name_;
+    int fd_;
+    std::uintptr_t task_;
+    char const *arg_name_ {nullptr};
+    std::int64_t arg_ {0};
+    std::uint64_t start_ {0};
+};
+
+auto dump(std::ostream &os) -> void;
+
+/*
+ * Discards what every thread recorded, dropped counts included, and releases
+ * the buffers; a thread allocates a new one on its next record.
+ */
+auto clear() -> void;
+
+/*
+ * Records dropped on full buffers since the last clear(), over all threads.
+ */
+auto dropped() -> std::size_t;
+
+} /* namespace bc::async::trace */
+
+#endif /* __BC_ASYNC_TRACE_H__ */
@@ -6,5 +6,7 @@
 #include "async/async.hpp"
 #include "log/log.hpp"
 #include "network/network.hpp"
+#include "http/http.hpp"
+#include "rpc/rpc.hpp"
 
 #endif /* __BC_CORE_H__ */
@@ -0,0 +1,10 @@
+#pragma once
+
+#ifndef __BC_HTTP_H__
+#define __BC_HTTP_H__
+
+#include "parser.hpp"
+#include "response.hpp"
+#include "server.hpp"
+
+#endif /* __BC_HTTP_H__ */
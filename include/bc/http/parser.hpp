@@ -0,0 +1,87 @@
+#pragma once
+
+#ifndef __BC_HTTP_PARSER_H__
+#define __BC_HTTP_PARSER_H__
+
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include <bc/utils/expected.hpp>
+
+namespace bc::http {
+
+enum class scan_backend {
+    SCALAR,
+    SSE42,
+    AVX2,
+};
+
+/*
+ * Selects the instructions the parser scans with, process-wide. By default
+ * the best one the cpu supports is used; asking for more than it supports
+ * falls back to the best available.
+ */
+auto set_scan_backend(scan_backend backend) -> void;
+auto current_scan_backend() -> scan_backend;
+
+struct limits {
+    /* request line and headers together, the terminating blank line included */
+    std::size_t max_header_bytes {8 << 10};
+    std::size_t max_headers {64};
+    std::size_t max_body {1 << 20};
+};
+
+struct header {
+    std::string_view name;
+    std::string_view value;
+};
+
+/*
+ * A parsed request. Every view points into the buffer it was parsed from
+ * and is only valid as long as those bytes are.
+ */
+struct request {
+    std::string_view method;
+    std::string_view target;
+    int minor_version {1};
+    std::vector<http::header> headers;
+    std::size_t content_length {0};
+    bool chunked {false};
+    bool keep_alive {true};
+    std::string_view body;
+
+    /*
+     * The target without its query string.
+     */
+    auto path() const -> std::string_view {
+        return target.substr(0, target.find('?'));
+    }
+
+    auto query() const -> std::string_view {
+        auto pos = target.find('?');
+        return pos == std::string_view::npos ? std::string_view {} : target.substr(pos + 1);
+    }
+
+    /*
+     * The first header named name, compared case-insensitively.
+     */
+    auto header(std::string_view name) const -> std::optional<std::string_view>;
+};
+
+/*
+ * Parses the request line and headers at the start of data into req, body
+ * excluded. Resumable only from scratch: on 0 the caller reads more and calls
+ * again with the grown buffer. Fails with bad_message on malformed input and
+ * with message_size when a limit on the head is exceeded.
+ *
+ * Returns the length of the head, or 0 when it is not complete yet.
+ */
+auto parse_request(std::span<char const> data, request &req, limits const &limits = {}) -> utils::expected<std::size_t, std::error_code>;
+
+} /* namespace bc::http */
+
+#endif /* __BC_HTTP_PARSER_H__ */
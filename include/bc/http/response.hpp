@@ -0,0 +1,132 @@
+#pragma once
+
+#ifndef __BC_HTTP_RESPONSE_H__
+#define __BC_HTTP_RESPONSE_H__
+
+#include <cstddef>
+#include <deque>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <bc/utils/noncopyable.hpp>
+
+namespace bc::http {
+
+/*
+ * The reason phrase of a status code, empty for unknown ones.
+ */
+auto reason_phrase(unsigned status) -> std::string_view;
+
+/*
+ * Filled in by a handler. Date, Content-Length and Connection are generated
+ * when the response is serialized and must not be set by hand.
+ */
+class response {
+    friend class response_batch;
+
+public:
+    auto set_status(unsigned status) -> response & {
+        status_ = status;
+        return *this;
+    }
+
+    auto set_header(std::string_view name, std::string_view value) -> response & {
+        headers_.append(name).append(": ").append(value).append("\r\n");
+        return *this;
+    }
+
+    auto set_body(std::string body, std::string_view content_type = {}) -> response & {
+        owned_ = std::move(body);
+        owns_ = true;
+        return content_type_(content_type);
+    }
+
+    /*
+     * A body that is not copied, for static or long-lived content; it must
+     * outlive the write of the response.
+     */
+    auto set_body_view(std::string_view body, std::string_view content_type = {}) -> response & {
+        owned_.clear();
+        view_ = body;
+        owns_ = false;
+        return content_type_(content_type);
+    }
+
+    /*
+     * Closes the connection once the response is written.
+     */
+    auto set_close() -> response & {
+        close_ = true;
+        return *this;
+    }
+
+    auto status() const -> unsigned { return status_; }
+    auto body() const -> std::string_view { return owns_ ? owned_ : view_; }
+    auto closing() const -> bool { return close_; }
+
+private:
+    auto content_type_(std::string_view content_type) -> response & {
+        if (!content_type.empty()) {
+            set_header("Content-Type", content_type);
+        }
+        return *this;
+    }
+
+private:
+    unsigned status_ {200};
+    std::string headers_;
+    // the view is kept apart so that moving the response cannot leave it
+    // pointing into a moved short string
+    std::string owned_;
+    std::string_view view_;
+    bool owns_ {false};
+    bool close_ {false};
+};
+
+/*
+ * Responses to one batch of pipelined requests, serialized back to back to
+ * go out in a single writev. Heads and small bodies are copied into one
+ * buffer; larger bodies are referenced in place, owned ones kept alive here
+ * until clear().
+ */
+class response_batch : private utils::noncopyable {
+    struct segment {
+        /* nullptr for a range of data_ */
+        char const *external;
+        std::size_t offset;
+        std::size_t size;
+    };
+
+public:
+    /* bodies up to this size are copied rather than given their own iovec */
+    constexpr static std::size_t s_copy_threshold = 1 << 10;
+
+    /*
+     * head_only leaves out the body, for HEAD requests.
+     */
+    auto append(response &&res, bool keep_alive, bool head_only = false) -> void;
+
+    /*
+     * Everything appended so far, valid until the next append or clear().
+     */
+    auto buffers() -> std::span<std::span<char const> const>;
+
+    auto empty() const -> bool { return data_.empty() && segments_.empty(); }
+    auto clear() -> void;
+
+private:
+    auto seal_() -> void;
+
+private:
+    std::string data_;
+    std::size_t mark_ {0};
+    std::vector<segment> segments_;
+    std::deque<std::string> owned_;
+    std::vector<std::span<char const>> buffers_;
+};
+
+} /* namespace bc::http */
+
+#endif /* __BC_HTTP_RESPONSE_H__ */
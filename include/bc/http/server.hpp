@@ -0,0 +1,227 @@
+#pragma once
+
+#ifndef __BC_HTTP_SERVER_H__
+#define __BC_HTTP_SERVER_H__
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <unordered_map>
+#include <utility>
+
+#include <bc/utils/error.hpp>
+#include <bc/utils/noncopyable.hpp>
+#include <bc/async/reactor.hpp>
+#include <bc/async/task.hpp>
+#include <bc/log/log.hpp>
+#include <bc/network/buffer_pool.hpp>
+#include <bc/network/server.hpp>
+#include <bc/network/socket.hpp>
+
+#include "parser.hpp"
+#include "response.hpp"
+
+namespace bc::http {
+
+namespace detail {
+
+struct path_hash {
+    using is_transparent = void;
+
+    auto operator()(std::string_view path) const -> std::size_t {
+        return std::hash<std::string_view> {}(path);
+    }
+};
+
+} /* namespace bc::http::detail */
+
+/*
+ * HTTP/1.1 on top of network::server. Every complete request a read brings
+ * in is parsed in place and answered before anything is written, so a
+ * pipelined batch costs one read and one writev. Handlers run synchronously
+ * on the connection's scheduler and must not block it.
+ *
+ * Request bodies need a Content-Length; chunked ones are refused with 501.
+ */
+template <network::domain Domain = network::domain::IPv4>
+class server : private utils::noncopyable {
+    using transport_server = network::server<network::protocol::TCP, Domain>;
+
+    /* read buffer taken from the pool, grown only for larger bodies */
+    constexpr static std::size_t s_buffer_size = 16 << 10;
+
+public:
+    using handler = std::function<auto (request const &, response &) -> void>;
+
+    server(std::string_view hostname, uint16_t port, limits limits = {}) : transport_(hostname, port), limits_(limits) {
+        tune_();
+    }
+    server(network::address addr, limits limits = {}) : transport_(std::move(addr)), limits_(limits) {
+        tune_();
+    }
+
+    /*
+     * Serves requests whose path, query string excluded, equals path. Routes
+     * must be set before start().
+     */
+    auto route(std::string_view path, handler h) -> void {
+        routes_.insert_or_assign(std::string(path), std::move(h));
+    }
+
+    /*
+     * Serves requests no route matches; without one they get a 404.
+     */
+    auto set_fallback(handler h) -> void {
+        fallback_ = std::move(h);
+    }
+
+    auto start() -> void {
+        transport_.start([this](network::socket<network::protocol::TCP> &sock) { return serve_(sock); });
+    }
+
+    auto start(async::reactor_pool &pool, network::accept_mode mode = network::accept_mode::DISPATCH) -> void {
+        transport_.start(pool, [this](network::socket<network::protocol::TCP> &sock) { return serve_(sock); }, mode);
+    }
+
+    /*
+     * The underlying server, for connection limits, socket options and
+     * stats. Peer options replace the TCP_NODELAY set by default.
+     */
+    auto transport() -> transport_server & { return transport_; }
+
+private:
+    auto tune_() -> void {
+        // responses are written whole, Nagle would only hold back the last
+        transport_.set_socket_options(network::role::PEER, {.no_delay = true});
+    }
+
+    /*
+     * A connection holds a buffer only while it has unparsed bytes; an idle
+     * keep-alive connection waits with none and borrows one from the
+     * thread's pool when data arrives.
+     */
+    auto serve_(network::socket<network::protocol::TCP> &sock) -> async::task<> {
+        auto &pool = network::default_buffer_pool();
+        auto buffer_size = std::max(s_buffer_size, limits_.max_header_bytes);
+        network::pooled_buffer buffer;
+        std::size_t begin = 0;
+        std::size_t end = 0;
+        request req;
+        response_batch batch;
+        bool open = true;
+        while (open) {
+            // bytes the request at begin needs, known once its head is parsed
+            std::size_t wanted = 0;
+            while (begin < end) {
+                std::span<char const> data {buffer.data() + begin, end - begin};
+                auto head = parse_request(data, req, limits_);
+                if (!head) {
+                    bool too_large = head.error() == utils::trans_error_code(utils::detail::message_size);
+                    batch.append(refusal_(too_large ? 431 : 400), false);
+                    open = false;
+                    break;
+                }
+                if (*head == 0) {
+                    break;
+                }
+                if (req.chunked || req.content_length > limits_.max_body) {
+                    batch.append(refusal_(req.chunked ? 501 : 413), false);
+                    open = false;
+                    break;
+                }
+                if (data.size() < *head + req.content_length) {
+                    wanted = *head + req.content_length;
+                    break;
+                }
+                req.body = {data.data() + *head, req.content_length};
+                response res;
+                handle_(req, res);
+                open = req.keep_alive && !res.closing();
+                batch.append(std::move(res), open, req.method == "HEAD");
+                begin += *head + req.content_length;
+                if (!open) {
+                    break;
+                }
+            }
+            if (!batch.empty()) {
+                auto res = co_await network::async_write_all(sock, batch.buffers());
+                batch.clear();
+                if (!res) {
+                    log::debug("failed to write responses, fd: {}, message: {}", sock.descriptor(), res.error().message());
+                    break;
+                }
+            }
+            if (!open) {
+                break;
+            }
+            if (begin == end) {
+                buffer = {};
+                begin = end = 0;
+                auto got = co_await network::async_read_borrowed(sock, pool, buffer_size);
+                if (!got) {
+                    break;
+                }
+                buffer = std::move(*got);
+                end = buffer.size();
+                continue;
+            }
+            // keep the unparsed tail at the front, where it has room to grow
+            if (begin > 0) {
+                std::memmove(buffer.data(), buffer.data() + begin, end - begin);
+                end -= begin;
+                begin = 0;
+            }
+            if (wanted > buffer.capacity()) {
+                auto larger = pool.acquire(wanted);
+                std::memcpy(larger.data(), buffer.data(), end);
+                buffer = std::move(larger);
+            }
+            auto n = co_await network::async_read(sock, {buffer.data() + end, buffer.capacity() - end});
+            if (!n || *n == 0) {
+                break;
+            }
+            end += *n;
+        }
+    }
+
+    auto handle_(request const &req, response &res) -> void {
+        try {
+            if (auto it = routes_.find(req.path()); it != routes_.end()) {
+                it->second(req, res);
+            }
+            else if (fallback_) {
+                fallback_(req, res);
+            }
+            else {
+                res.set_status(404).set_body_view("not found\n", "text/plain");
+            }
+        }
+        catch (std::exception const &e) {
+            log::error("handler failed, target: {}, message: {}", req.target, e.what());
+            res = response();
+            res.set_status(500).set_body_view("internal server error\n", "text/plain").set_close();
+        }
+    }
+
+    static auto refusal_(unsigned status) -> response {
+        response res;
+        res.set_status(status).set_body_view(reason_phrase(status), "text/plain");
+        return res;
+    }
+
+private:
+    transport_server transport_;
+    limits limits_;
+    std::unordered_map<std::string, handler, detail::path_hash, std::equal_to<>> routes_;
+    handler fallback_;
+};
+
+} /* namespace bc::http */
+
+#endif /* __BC_HTTP_SERVER_H__ */
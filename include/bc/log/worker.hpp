@@ -6,10 +6,12 @@
 #include <atomic>
 #include <condition_variable>
 #include <mutex>
+#include <semaphore>
 #include <thread>
 #include <utility>
 #include <vector>
 
+#include <bc/utils/affinity.hpp>
 #include <bc/utils/noncopyable.hpp>
 
 #include "record.hpp"
@@ -20,7 +22,7 @@ class logger;
 
 class worker : private utils::noncopyable {
     using logs = std::vector<std::pair<logger const &, record>>;
-    using waiter = std::pair<std::condition_variable &, std::atomic_bool &>;
+    using waiter = std::binary_semaphore *;
 
 public:
     worker() : thread_(&worker::loop_, this) {}
@@ -34,6 +36,13 @@ public:
     auto append(logger const &logger, record &&record) -> void;
     auto flush() -> void;
 
+    /*
+     * Keeps the background thread off the reactor cores. The thread is woken
+     * to apply the matching NUMA memory preference itself.
+     */
+    auto set_affinity(std::vector<int> const &cpus) -> void;
+    auto placement() -> utils::placement;
+
 private:
     auto drain_(logs &logs, std::vector<waiter> &waiters) -> void;
     auto loop_() -> void;
@@ -46,6 +55,7 @@ private:
     std::jthread thread_;
     std::atomic_bool stop_ {false};
     std::atomic_uint64_t length_ {0};
+    std::atomic_int node_ {-1};
 };
 
 auto background_worker() -> worker &;
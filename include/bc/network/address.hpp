@@ -7,12 +7,15 @@
 #include <netinet/in.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/un.h>
 
 #include <algorithm>
 #include <charconv>
 #include <cstddef>
+#include <cstring>
 #include <optional>
 #include <ranges>
+#include <string>
 #include <string_view>
 #include <system_error>
 #include <utility>
@@ -30,6 +33,16 @@ namespace bc::network {
 enum class domain {
     IPv4 = AF_INET,
     IPv6 = AF_INET6,
+    UNIX = AF_UNIX,
+};
+
+/*
+ * sockaddr_un with its length: abstract names are not null-terminated and
+ * may contain nulls, so the length is part of the address.
+ */
+struct unix_sockaddr {
+    sockaddr_un addr;
+    socklen_t len;
 };
 
 static auto parse_ipv4(std::string_view hostname) -> std::optional<uint32_t> {
@@ -165,19 +178,62 @@ public:
         return utils::trans_error_code(utils::detail::invalid_address);
     }
 
+    /*
+     * A Unix domain address: a filesystem path, or a name in the abstract
+     * namespace when it starts with '@', which never touches the filesystem
+     * and vanishes with its last socket.
+     */
+    static auto from_path(std::string_view path) -> utils::expected<address, std::error_code> {
+        unix_sockaddr sockaddr {};
+        sockaddr.addr.sun_family = AF_UNIX;
+        bool abstract = path.starts_with('@');
+        // a filesystem path needs room for its terminating null
+        if (path.empty() || path.size() + !abstract > sizeof(sockaddr.addr.sun_path)) {
+            return utils::trans_error_code(utils::detail::invalid_address);
+        }
+        std::memcpy(sockaddr.addr.sun_path + abstract, path.data() + abstract, path.size() - abstract);
+        sockaddr.len = offsetof(sockaddr_un, sun_path) + path.size() + !abstract;
+        return address(sockaddr);
+    }
+
+    /*
+     * For addresses the kernel filled in: recvfrom, accept, getpeername.
+     */
+    static auto from(sockaddr_storage const &storage, socklen_t len) -> utils::expected<address, std::error_code> {
+        if (storage.ss_family == AF_INET && len >= sizeof(sockaddr_in)) {
+            return address(reinterpret_cast<sockaddr_in const &>(storage));
+        }
+        if (storage.ss_family == AF_INET6 && len >= sizeof(sockaddr_in6)) {
+            return address(reinterpret_cast<sockaddr_in6 const &>(storage));
+        }
+        if (storage.ss_family == AF_UNIX && len >= offsetof(sockaddr_un, sun_path) && len <= sizeof(sockaddr_un)) {
+            unix_sockaddr sockaddr {};
+            std::memcpy(&sockaddr.addr, &storage, len);
+            sockaddr.len = len;
+            return address(sockaddr);
+        }
+        return utils::trans_error_code(utils::detail::invalid_address);
+    }
+
 public:
+    address() = default;
     address(sockaddr_in const &addr) : sockaddr_(addr) {}
     address(sockaddr_in6 const &addr) : sockaddr_(addr) {}
+    address(unix_sockaddr const &addr) : sockaddr_(addr) {}
     address(std::string_view hostname, uint16_t port) : address(*from(hostname, port)) {}
 
     auto sockaddr() const -> sockaddr const * {
-        return std::visit(utils::overload([](auto const &sockaddr) {
+        return std::visit(utils::overload([](unix_sockaddr const &sockaddr) {
+            return reinterpret_cast<struct sockaddr const *>(&sockaddr.addr);
+        }, [](auto const &sockaddr) {
             return reinterpret_cast<struct sockaddr const *>(&sockaddr);
         }), sockaddr_);
     }
 
     auto socklen() const -> std::size_t {
-        return std::visit(utils::overload([](auto const &sockaddr) {
+        return std::visit(utils::overload([](unix_sockaddr const &sockaddr) -> std::size_t {
+            return sockaddr.len;
+        }, [](auto const &sockaddr) {
             return sizeof(sockaddr);
         }), sockaddr_);
     }
@@ -187,9 +243,28 @@ public:
             return network::domain::IPv4;
         }, [](sockaddr_in6 const &sockaddr) {
             return network::domain::IPv6;
+        }, [](unix_sockaddr const &sockaddr) {
+            return network::domain::UNIX;
         }), sockaddr_);
     }
 
+    /*
+     * The path of a Unix domain address, '@' leading abstract names, empty
+     * for unnamed sockets such as socketpair ends.
+     */
+    auto path() const -> std::string {
+        auto const *sockaddr = std::get_if<unix_sockaddr>(&sockaddr_);
+        if (!sockaddr || sockaddr->len <= offsetof(sockaddr_un, sun_path)) {
+            return {};
+        }
+        auto const *p = sockaddr->addr.sun_path;
+        auto size = sockaddr->len - offsetof(sockaddr_un, sun_path);
+        if (p[0] == '\0') {
+            return "@" + std::string(p + 1, size - 1);
+        }
+        return std::string(p, ::strnlen(p, size));
+    }
+
 private:
     template <typename context>
     auto expr(context &ctx) const {
@@ -206,11 +281,13 @@ private:
                 return ::ntohs(n);
             });
             return fmt::format_to(ctx.out(), "[{:x}:{:x}:{:x}:{:x}:{:x}:{:x}:{:x}:{:x}]:{}", numbers[0], numbers[1], numbers[2], numbers[3], numbers[4], numbers[5], numbers[6], numbers[7], ::ntohs(sockaddr.sin6_port));
+        }, [&](unix_sockaddr const &) {
+            return fmt::format_to(ctx.out(), "unix:{}", path());
         }), sockaddr_);
     }
 
 private:
-    std::variant<sockaddr_in, sockaddr_in6> sockaddr_;
+    std::variant<sockaddr_in, sockaddr_in6, unix_sockaddr> sockaddr_;
 };
 
 } /* namespace bc::network */
@@ -218,7 +295,7 @@ private:
 namespace fmt {
 
 template <>
-class fmt::formatter<bc::network::address> {
+class formatter<bc::network::address> {
 public:
     constexpr auto parse(fmt::format_parse_context &ctx) { return ctx.begin(); }
     template <typename context>
@@ -0,0 +1,386 @@
+#pragma once
+
+#ifndef __BC_NETWORK_BUFFER_POOL_H__
+#define __BC_NETWORK_BUFFER_POOL_H__
+
+#include <sys/mman.h>
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cerrno>
+#include <coroutine>
+#include <cstddef>
+#include <cstring>
+#include <span>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <bc/utils/error.hpp>
+#include <bc/utils/expected.hpp>
+#include <bc/utils/memory.hpp>
+#include <bc/utils/noncopyable.hpp>
+#include <bc/async/scheduler.hpp>
+#include <bc/async/trace.hpp>
+#include <bc/log/log.hpp>
+
+#include "socket.hpp"
+
+namespace bc::network {
+
+struct buffer_pool_options {
+    /* back chunks with 2 MiB pages: MAP_HUGETLB, else transparent hugepages */
+    bool hugepages {false};
+    /* bytes mapped at a time and carved into buffers of one class */
+    std::size_t chunk_size {2 << 20};
+};
+
+class buffer_pool;
+
+namespace detail {
+
+class buffer_arena;
+
+} /* namespace bc::network::detail */
+
+/*
+ * A buffer lent by a buffer_pool, returned to it on destruction. size() is
+ * the filled part, capacity() the whole page-aligned block.
+ */
+class pooled_buffer : private utils::noncopyable {
+    friend class detail::buffer_arena;
+
+public:
+    pooled_buffer() = default;
+    pooled_buffer(pooled_buffer &&other) : arena_(other.arena_), data_(other.data_), size_(other.size_), capacity_(other.capacity_), class_(other.class_) {
+        other.arena_ = nullptr;
+    }
+    auto operator =(pooled_buffer &&other) -> pooled_buffer & {
+        if (this != &other) {
+            release_();
+            arena_ = other.arena_;
+            data_ = other.data_;
+            size_ = other.size_;
+            capacity_ = other.capacity_;
+            class_ = other.class_;
+            other.arena_ = nullptr;
+        }
+        return *this;
+    }
+    ~pooled_buffer() {
+        release_();
+    }
+
+    auto data() const -> char * { return data_; }
+    auto size() const -> std::size_t { return size_; }
+    auto capacity() const -> std::size_t { return capacity_; }
+    auto resize(std::size_t size) -> void {
+        assert(size <= capacity());
+        size_ = size;
+    }
+
+    auto span() const -> std::span<char> { return {data_, size_}; }
+    operator std::span<char>() const { return span(); }
+
+private:
+    pooled_buffer(detail::buffer_arena *arena, char *data, std::size_t capacity, std::size_t klass)
+        : arena_(arena), data_(data), size_(capacity), capacity_(capacity), class_(klass) {}
+
+    auto release_() -> void;
+
+private:
+    detail::buffer_arena *arena_ {nullptr};
+    char *data_ {nullptr};
+    std::size_t size_ {0};
+    std::size_t capacity_ {0};
+    std::size_t class_ {0};
+};
+
+namespace detail {
+
+constexpr std::array<std::size_t, 5> s_buffer_classes {4 << 10, 16 << 10, 64 << 10, 256 << 10, 1 << 20};
+/* the class of a buffer above the largest, mapped for itself */
+constexpr std::size_t s_dedicated_class = s_buffer_classes.size();
+
+/*
+ * The memory behind a buffer_pool. It lives on the heap so that it can
+ * outlive its pool: a pool destroyed with buffers still out, e.g. the
+ * thread_local default pool at thread exit while a suspended session holds
+ * one, leaves the arena to be freed by the last buffer returned.
+ */
+class buffer_arena : private utils::noncopyable {
+public:
+    constexpr static std::size_t s_huge_page = 2 << 20;
+    constexpr static std::size_t s_page = 4 << 10;
+
+public:
+    explicit buffer_arena(buffer_pool_options options) : options_(options) {}
+    ~buffer_arena() {
+        for (auto [p, size] : chunks_) {
+            ::munmap(p, size);
+            utils::memory::sub(utils::memory::category::SOCKET_BUFFERS, size);
+        }
+    }
+
+    auto acquire(std::size_t size) -> pooled_buffer {
+        if (size > s_buffer_classes.back()) {
+            return map_dedicated_(size);
+        }
+        std::size_t klass = 0;
+        while (s_buffer_classes[klass] < size) {
+            ++klass;
+        }
+        auto &free = free_[klass];
+        if (free.empty()) {
+            refill_(klass);
+        }
+        auto *p = free.back();
+        free.pop_back();
+        ++lent_;
+        return {this, p, s_buffer_classes[klass], klass};
+    }
+
+    /*
+     * Returns true when the arena is done with and must be deleted.
+     */
+    auto release(char *p, std::size_t capacity, std::size_t klass) -> bool {
+        if (klass == s_dedicated_class) {
+            ::munmap(p, capacity);
+            utils::memory::sub(utils::memory::category::SOCKET_BUFFERS, capacity);
+            dedicated_ -= capacity;
+        }
+        else {
+            free_[klass].push_back(p);
+        }
+        --lent_;
+        return orphaned_ && lent_ == 0;
+    }
+
+    /*
+     * The pool is going away; returns true when nothing is lent and the
+     * arena can go with it.
+     */
+    auto orphan() -> bool {
+        orphaned_ = true;
+        return lent_ == 0;
+    }
+
+    auto lent() const -> std::size_t { return lent_; }
+    auto mapped() const -> std::size_t {
+        std::size_t bytes = dedicated_;
+        for (auto [p, size] : chunks_) {
+            bytes += size;
+        }
+        return bytes;
+    }
+
+private:
+    /*
+     * size is a multiple of s_huge_page when hugepages are asked for.
+     */
+    auto map_(std::size_t size) -> char * {
+        void *p = MAP_FAILED;
+        if (options_.hugepages) {
+            p = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (p == MAP_FAILED) {
+                log::debug("no hugetlb pages for buffer pool, errno: {}, message: {}", errno, ::strerror(errno));
+            }
+        }
+        if (p == MAP_FAILED) {
+            p = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (p == MAP_FAILED) {
+                log::error("failed to map buffer chunk, size: {}, errno: {}, message: {}", size, errno, ::strerror(errno));
+                throw utils::trans_error_code(errno);
+            }
+            if (options_.hugepages) {
+                ::madvise(p, size, MADV_HUGEPAGE);
+            }
+        }
+        utils::memory::add(utils::memory::category::SOCKET_BUFFERS, size);
+        return static_cast<char *>(p);
+    }
+
+    auto refill_(std::size_t klass) -> void {
+        auto size = std::max(options_.chunk_size, s_buffer_classes[klass]);
+        if (options_.hugepages) {
+            size = (size + s_huge_page - 1) / s_huge_page * s_huge_page;
+        }
+        auto *p = map_(size);
+        chunks_.emplace_back(p, size);
+        for (std::size_t offset = 0; offset + s_buffer_classes[klass] <= size; offset += s_buffer_classes[klass]) {
+            free_[klass].push_back(p + offset);
+        }
+    }
+
+    /*
+     * Too large to recycle: mapped for the caller and unmapped on release.
+     */
+    auto map_dedicated_(std::size_t size) -> pooled_buffer {
+        size = (size + s_page - 1) / s_page * s_page;
+        // no hugepages here, they would round a one-off mapping up to 2 MiB
+        void *p = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED) {
+            log::error("failed to map buffer, size: {}, errno: {}, message: {}", size, errno, ::strerror(errno));
+            throw utils::trans_error_code(errno);
+        }
+        utils::memory::add(utils::memory::category::SOCKET_BUFFERS, size);
+        dedicated_ += size;
+        ++lent_;
+        return {this, static_cast<char *>(p), size, s_dedicated_class};
+    }
+
+private:
+    buffer_pool_options options_;
+    std::array<std::vector<char *>, s_buffer_classes.size()> free_;
+    std::vector<std::pair<char *, std::size_t>> chunks_;
+    std::size_t dedicated_ {0};
+    std::size_t lent_ {0};
+    bool orphaned_ {false};
+};
+
+} /* namespace bc::network::detail */
+
+/*
+ * Size-classed, page-aligned buffers recycled through per-class free lists.
+ * Memory is mapped a chunk at a time, charged to SOCKET_BUFFERS, and kept
+ * until the pool and every buffer it lent are gone. Requests above the
+ * largest class get a mapping of their own, unmapped on release. A pool is
+ * not thread-safe: buffers must be returned on the thread that owns it, see
+ * default_buffer_pool().
+ */
+class buffer_pool : private utils::noncopyable {
+public:
+    constexpr static auto s_classes = detail::s_buffer_classes;
+    constexpr static std::size_t s_huge_page = detail::buffer_arena::s_huge_page;
+
+public:
+    explicit buffer_pool(buffer_pool_options options = {}) : arena_(new detail::buffer_arena(options)) {}
+    ~buffer_pool() {
+        if (arena_->orphan()) {
+            delete arena_;
+        }
+        else {
+            log::debug("buffer pool destroyed with {} buffers lent, memory kept until they return", arena_->lent());
+        }
+    }
+
+    /*
+     * A buffer of the smallest class holding size bytes, or a page-rounded
+     * mapping of its own above the largest class, with size() set to its
+     * capacity.
+     */
+    auto acquire(std::size_t size) -> pooled_buffer {
+        return arena_->acquire(size);
+    }
+
+    auto lent() const -> std::size_t { return arena_->lent(); }
+    auto mapped() const -> std::size_t { return arena_->mapped(); }
+
+private:
+    // owned, unless orphaned by the destructor
+    detail::buffer_arena *arena_;
+};
+
+inline auto pooled_buffer::release_() -> void {
+    if (arena_) {
+        if (arena_->release(data_, capacity_, class_)) {
+            delete arena_;
+        }
+        arena_ = nullptr;
+    }
+}
+
+/*
+ * The calling thread's pool, so reactors never share free lists.
+ */
+inline auto default_buffer_pool() -> buffer_pool & {
+    thread_local buffer_pool pool;
+    return pool;
+}
+
+namespace detail {
+
+/*
+ * Waits for data without holding a buffer; one is taken from the pool only
+ * for the read itself and handed back at once if the read would block.
+ */
+template <protocol proto>
+class async_borrowed_read_awaiter {
+public:
+    async_borrowed_read_awaiter(socket<proto> &sock, buffer_pool &pool, std::size_t size) : sock_(sock), pool_(pool), size_(size) {}
+
+    auto await_ready() -> bool {
+        return read_();
+    }
+
+    auto await_suspend(std::coroutine_handle<> handle) noexcept -> bool {
+        async::trace::instant("suspend_borrowed_read", sock_.descriptor(), handle.address());
+        async::default_scheduler().post_coro(
+            sock_.descriptor(),
+            async::READ | async::ERROR | async::HANGUP | async::RDHANGUP,
+            revent_,
+            [this, next=handle] {
+                if (!read_()) {
+                    return false;
+                }
+                next.resume();
+                return true;
+            }
+        );
+        return true;
+    }
+
+    auto await_resume() noexcept -> utils::expected<pooled_buffer, std::error_code> {
+        return std::move(res_);
+    }
+
+private:
+    /*
+     * Returns false when the read would block.
+     */
+    auto read_() -> bool {
+        auto buffer = pool_.acquire(size_);
+        auto res = sock_.read(buffer);
+        if (!res) {
+            if (utils::would_block(res.error())) {
+                return false;
+            }
+            res_ = res.error();
+        }
+        else if (*res == 0) {
+            res_ = utils::trans_error_code(utils::detail::closed_by_peer);
+        }
+        else {
+            buffer.resize(*res);
+            res_ = std::move(buffer);
+        }
+        return true;
+    }
+
+private:
+    socket<proto> &sock_;
+    buffer_pool &pool_;
+    std::size_t size_;
+    async::event revent_ {async::NONE};
+    utils::expected<pooled_buffer, std::error_code> res_;
+};
+
+} /* namespace bc::network::detail */
+
+/*
+ * Resumes with a buffer holding what arrived, at most size bytes rounded up
+ * to a size class; the buffer goes back to the pool when dropped.
+ */
+template <protocol proto>
+inline auto async_read_borrowed(socket<proto> &sock, buffer_pool &pool, std::size_t size = buffer_pool::s_classes[1]) -> detail::async_borrowed_read_awaiter<proto> {
+    return {sock, pool, size};
+}
+
+template <protocol proto>
+inline auto async_read_borrowed(socket<proto> &sock, std::size_t size = buffer_pool::s_classes[1]) -> detail::async_borrowed_read_awaiter<proto> {
+    return {sock, default_buffer_pool(), size};
+}
+
+} /* namespace bc::network */
+
+#endif /* __BC_NETWORK_BUFFER_POOL_H__ */
@@ -0,0 +1,288 @@
+#pragma once
+
+#ifndef __BC_NETWORK_BUFFERED_STREAM_H__
+#define __BC_NETWORK_BUFFERED_STREAM_H__
+
+#include <sys/mman.h>
+#include <unistd.h>
+#include <bit>
+#include <cerrno>
+#include <concepts>
+#include <coroutine>
+#include <cstddef>
+#include <cstring>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+#include <bc/utils/error.hpp>
+#include <bc/utils/expected.hpp>
+#include <bc/utils/memory.hpp>
+#include <bc/utils/noncopyable.hpp>
+#include <bc/async/scheduler.hpp>
+#include <bc/async/trace.hpp>
+#include <bc/log/log.hpp>
+
+namespace bc::network {
+
+/*
+ * Anything with a non-blocking read reporting would-block as an error, like
+ * socket and async::fd_stream.
+ */
+template <typename Stream>
+concept readable_stream = requires(Stream &stream, std::span<char> buffer) {
+    { stream.read(buffer) } -> std::same_as<utils::expected<std::size_t, std::error_code>>;
+    { stream.descriptor() } -> std::convertible_to<int>;
+};
+
+template <readable_stream Stream>
+class buffered_stream;
+
+namespace detail {
+
+/*
+ * Match is called with the buffered bytes and returns the (skip, length) of
+ * the view to hand out, or nothing until more bytes arrive.
+ */
+template <typename Stream, typename Result, typename Match>
+class buffered_read_awaiter {
+public:
+    buffered_read_awaiter(buffered_stream<Stream> &stream, Match match) : stream_(stream), match_(std::move(match)) {}
+
+    auto await_ready() -> bool {
+        return step_();
+    }
+
+    auto await_suspend(std::coroutine_handle<> handle) noexcept -> bool {
+        async::trace::instant("suspend_buffered_read", stream_.stream_.descriptor(), handle.address());
+        async::default_scheduler().post_coro(
+            stream_.stream_.descriptor(),
+            async::READ | async::ERROR | async::HANGUP | async::RDHANGUP,
+            revent_,
+            [this, next=handle] {
+                if (!step_()) {
+                    return false;
+                }
+                next.resume();
+                return true;
+            }
+        );
+        return true;
+    }
+
+    auto await_resume() noexcept -> utils::expected<Result, std::error_code> {
+        return std::move(res_);
+    }
+
+private:
+    /*
+     * Returns false when the stream would block before a match.
+     */
+    auto step_() -> bool {
+        while (true) {
+            auto data = stream_.buffered();
+            if (auto match = match_(data)) {
+                auto [skip, length] = *match;
+                res_ = Result(data.data() + skip, length);
+                stream_.pending_ = skip + length;
+                return true;
+            }
+            if (data.size() == stream_.capacity()) {
+                res_ = utils::trans_error_code(utils::detail::message_size);
+                return true;
+            }
+            auto res = stream_.fill_();
+            if (!res) {
+                if (utils::would_block(res.error())) {
+                    return false;
+                }
+                res_ = res.error();
+                return true;
+            }
+            if (*res == 0) {
+                res_ = utils::trans_error_code(utils::detail::closed_by_peer);
+                return true;
+            }
+        }
+    }
+
+private:
+    buffered_stream<Stream> &stream_;
+    Match match_;
+    async::event revent_ {async::NONE};
+    utils::expected<Result, std::error_code> res_;
+};
+
+} /* namespace bc::network::detail */
+
+/*
+ * Reads a stream in large chunks into a ring buffer and hands out views of
+ * lines, fixed-size records and length-prefixed frames. The ring is one
+ * memfd mapped twice back to back, so whatever the buffer holds is contiguous
+ * in memory and no view is ever copied or split at the wrap point. A view
+ * stays valid until the next read call, which consumes it; a record larger
+ * than the capacity fails with message_size.
+ */
+template <readable_stream Stream>
+class buffered_stream : private utils::noncopyable {
+    template <typename, typename, typename>
+    friend class detail::buffered_read_awaiter;
+
+public:
+    constexpr static std::size_t s_default_capacity = 64 << 10;
+
+public:
+    explicit buffered_stream(Stream &stream, std::size_t capacity = s_default_capacity) : stream_(stream) {
+        auto page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+        capacity_ = (capacity + page - 1) / page * page;
+        int fd = ::memfd_create("bc-buffered-stream", MFD_CLOEXEC);
+        if (fd == -1) {
+            log::error("failed to create memfd, errno: {}, message: {}", errno, ::strerror(errno));
+            throw utils::trans_error_code(errno);
+        }
+        if (::ftruncate(fd, capacity_) == -1) {
+            log::error("failed to size memfd, errno: {}, message: {}", errno, ::strerror(errno));
+            ::close(fd);
+            throw utils::trans_error_code(errno);
+        }
+        // reserve both halves first so the second mapping cannot land elsewhere
+        void *base = ::mmap(nullptr, capacity_ * 2, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        bool mapped = base != MAP_FAILED
+            && ::mmap(base, capacity_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) != MAP_FAILED
+            && ::mmap(static_cast<char *>(base) + capacity_, capacity_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) != MAP_FAILED;
+        auto error = errno;
+        ::close(fd);
+        if (!mapped) {
+            log::error("failed to map ring buffer, errno: {}, message: {}", error, ::strerror(error));
+            if (base != MAP_FAILED) {
+                ::munmap(base, capacity_ * 2);
+            }
+            throw utils::trans_error_code(error);
+        }
+        base_ = static_cast<char *>(base);
+        utils::memory::add(utils::memory::category::SOCKET_BUFFERS, capacity_);
+    }
+
+    ~buffered_stream() {
+        ::munmap(base_, capacity_ * 2);
+        utils::memory::sub(utils::memory::category::SOCKET_BUFFERS, capacity_);
+    }
+
+    /*
+     * Resumes with the bytes up to and including the first delimiter.
+     */
+    auto read_until(std::string_view delimiter) {
+        consume_();
+        auto match = [delimiter, scanned=std::size_t {0}](std::span<char const> data) mutable -> std::optional<std::pair<std::size_t, std::size_t>> {
+            if (auto pos = find_(data, delimiter, scanned)) {
+                return std::pair {std::size_t {0}, *pos + delimiter.size()};
+            }
+            // a delimiter may straddle the end of what has arrived so far
+            scanned = data.size() >= delimiter.size() ? data.size() - delimiter.size() + 1 : 0;
+            return std::nullopt;
+        };
+        return detail::buffered_read_awaiter<Stream, std::string_view, decltype(match)>(*this, std::move(match));
+    }
+
+    auto read_exact(std::size_t n) {
+        consume_();
+        auto match = [n](std::span<char const> data) -> std::optional<std::pair<std::size_t, std::size_t>> {
+            if (data.size() >= n) {
+                return std::pair {std::size_t {0}, n};
+            }
+            return std::nullopt;
+        };
+        return detail::buffered_read_awaiter<Stream, std::span<char const>, decltype(match)>(*this, std::move(match));
+    }
+
+    /*
+     * Resumes with the payload of a frame led by its length as a big-endian
+     * LengthPrefix.
+     */
+    template <std::unsigned_integral LengthPrefix>
+    auto read_frame() {
+        consume_();
+        auto match = [](std::span<char const> data) -> std::optional<std::pair<std::size_t, std::size_t>> {
+            if (data.size() < sizeof(LengthPrefix)) {
+                return std::nullopt;
+            }
+            LengthPrefix length;
+            std::memcpy(&length, data.data(), sizeof(length));
+            if constexpr (std::endian::native == std::endian::little && sizeof(LengthPrefix) > 1) {
+                length = std::byteswap(length);
+            }
+            if (data.size() - sizeof(LengthPrefix) < length) {
+                return std::nullopt;
+            }
+            return std::pair {sizeof(LengthPrefix), static_cast<std::size_t>(length)};
+        };
+        return detail::buffered_read_awaiter<Stream, std::span<char const>, decltype(match)>(*this, std::move(match));
+    }
+
+    /*
+     * What has been read from the stream but not handed out yet.
+     */
+    auto buffered() const -> std::span<char const> {
+        return {base_ + head_ % capacity_, tail_ - head_};
+    }
+
+    auto capacity() const -> std::size_t { return capacity_; }
+    auto stream() -> Stream & { return stream_; }
+
+private:
+    auto consume_() -> void {
+        head_ += pending_;
+        pending_ = 0;
+        if (head_ == tail_) {
+            head_ = tail_ = 0;
+        }
+    }
+
+    /*
+     * One read into all the free space.
+     */
+    auto fill_() -> utils::expected<std::size_t, std::error_code> {
+        auto res = stream_.read({base_ + tail_ % capacity_, capacity_ - (tail_ - head_)});
+        if (res) {
+            tail_ += *res;
+        }
+        return res;
+    }
+
+    /*
+     * memchr for the first byte, which glibc vectorizes, then a compare of
+     * the rest at each candidate.
+     */
+    static auto find_(std::span<char const> data, std::string_view delimiter, std::size_t from) -> std::optional<std::size_t> {
+        if (delimiter.empty() || data.size() < delimiter.size()) {
+            return std::nullopt;
+        }
+        auto const *p = data.data() + from;
+        auto const *last = data.data() + data.size() - delimiter.size() + 1;
+        while (p < last) {
+            p = static_cast<char const *>(std::memchr(p, delimiter.front(), last - p));
+            if (!p) {
+                return std::nullopt;
+            }
+            if (std::memcmp(p + 1, delimiter.data() + 1, delimiter.size() - 1) == 0) {
+                return p - data.data();
+            }
+            ++p;
+        }
+        return std::nullopt;
+    }
+
+private:
+    Stream &stream_;
+    char *base_ {nullptr};
+    std::size_t capacity_ {0};
+    std::size_t head_ {0};
+    std::size_t tail_ {0};
+    std::size_t pending_ {0};
+};
+
+} /* namespace bc::network */
+
+#endif /* __BC_NETWORK_BUFFERED_STREAM_H__ */
@@ -18,7 +18,10 @@ class client : private utils::noncopyable {
 public:
     template <typename F>
     auto async_connect(std::string_view hostname, uint16_t port, F &&f) -> async::task<> {
-        co_await sock_.async_connect({hostname, port});
+        if (auto ec = co_await sock_.async_connect({hostname, port})) {
+            log::error("failed to connect to {}:{}, message: {}", hostname, port, ec.message());
+            co_return;
+        }
         handler_ = std::forward<F>(f);
         task_ = handler_(sock_);
     }
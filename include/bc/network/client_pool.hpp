@@ -0,0 +1,319 @@
+#pragma once
+
+#ifndef __BC_NETWORK_CLIENT_POOL_H__
+#define __BC_NETWORK_CLIENT_POOL_H__
+
+#include <sys/socket.h>
+#include <cerrno>
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <fmt/format.h>
+
+#include <bc/utils/error.hpp>
+#include <bc/utils/expected.hpp>
+#include <bc/utils/noncopyable.hpp>
+#include <bc/async/scheduler.hpp>
+#include <bc/async/sleep.hpp>
+#include <bc/async/task.hpp>
+#include <bc/log/log.hpp>
+
+#include "address.hpp"
+#include "socket.hpp"
+
+namespace bc::network {
+
+struct client_pool_options {
+    /* open connections per host, leased and idle together */
+    std::size_t max_per_host {16};
+    /* idle connections kept warm per host; extra ones are closed on release */
+    std::size_t max_idle_per_host {8};
+    /* handshakes in flight across all hosts */
+    std::size_t max_connecting {32};
+    /* idle connections older than this are closed by maintain() */
+    std::chrono::milliseconds idle_timeout {std::chrono::seconds(30)};
+    /* period of maintain() rounds */
+    std::chrono::milliseconds check_interval {std::chrono::seconds(5)};
+};
+
+namespace detail {
+
+class pool_wait_awaiter {
+public:
+    pool_wait_awaiter(std::deque<std::coroutine_handle<>> &waiters) : waiters_(waiters) {}
+
+    auto await_ready() noexcept -> bool { return false; }
+    auto await_suspend(std::coroutine_handle<> handle) -> void {
+        waiters_.push_back(handle);
+    }
+    auto await_resume() noexcept -> void {}
+
+private:
+    std::deque<std::coroutine_handle<>> &waiters_;
+};
+
+} /* namespace bc::network::detail */
+
+/*
+ * Outbound connections kept warm per address. acquire() hands out an idle
+ * connection when one is still alive, otherwise connects, waiting while the
+ * host is at max_per_host or the pool at max_connecting so that a burst of
+ * callers does not turn into a SYN storm. The lease returns its connection
+ * on destruction unless discard() was called, e.g. after a protocol error.
+ *
+ * A pool belongs to one scheduler; leases and waiters must not outlive it.
+ */
+template <protocol Protocol>
+class client_pool : private utils::noncopyable {
+    using time_point = decltype(std::chrono::steady_clock::now());
+
+    struct idle_entry {
+        socket<Protocol> sock;
+        time_point since;
+    };
+
+    struct host {
+        address addr;
+        std::size_t open {0};
+        std::vector<idle_entry> idle;
+        std::deque<std::coroutine_handle<>> waiters;
+    };
+
+public:
+    class lease : private utils::noncopyable {
+        friend class client_pool;
+
+    public:
+        lease() = default;
+        lease(lease &&other) : pool_(other.pool_), host_(other.host_), sock_(std::move(other.sock_)), reusable_(other.reusable_) {
+            other.pool_ = nullptr;
+        }
+        auto operator =(lease &&other) -> lease & {
+            if (this != &other) {
+                release_();
+                pool_ = other.pool_;
+                host_ = other.host_;
+                sock_ = std::move(other.sock_);
+                reusable_ = other.reusable_;
+                other.pool_ = nullptr;
+            }
+            return *this;
+        }
+        ~lease() {
+            release_();
+        }
+
+        auto sock() -> socket<Protocol> & { return sock_; }
+        auto operator->() -> socket<Protocol> * { return &sock_; }
+
+        /*
+         * The connection is closed on release instead of reused.
+         */
+        auto discard() -> void { reusable_ = false; }
+
+    private:
+        lease(client_pool *pool, host *host, socket<Protocol> &&sock) : pool_(pool), host_(host), sock_(std::move(sock)) {}
+
+        auto release_() -> void {
+            if (pool_) {
+                pool_->release_(*host_, std::move(sock_), reusable_);
+                pool_ = nullptr;
+            }
+        }
+
+    private:
+        client_pool *pool_ {nullptr};
+        host *host_ {nullptr};
+        socket<Protocol> sock_;
+        bool reusable_ {true};
+    };
+
+    using health_check = std::function<auto (socket<Protocol> &) -> async::task<bool>>;
+
+public:
+    explicit client_pool(client_pool_options options = {}) : options_(options) {}
+
+    auto acquire(address addr) -> async::task<utils::expected<lease, std::error_code>> {
+        auto &host = host_(addr);
+        while (true) {
+            while (!host.idle.empty()) {
+                // most recently used first: its peer is the least likely to
+                // have timed it out
+                auto sock = std::move(host.idle.back().sock);
+                host.idle.pop_back();
+                if (alive_(sock)) {
+                    co_return lease(this, &host, std::move(sock));
+                }
+                --host.open;
+            }
+            if (host.open < options_.max_per_host && connecting_ < options_.max_connecting) {
+                break;
+            }
+            co_await detail::pool_wait_awaiter(host.open < options_.max_per_host ? connect_waiters_ : host.waiters);
+        }
+
+        ++host.open;
+        ++connecting_;
+        socket<Protocol> sock;
+        std::error_code ec;
+        try {
+            ec = co_await sock.async_connect(host.addr);
+        }
+        catch (std::error_code const &e) {
+            // creating the socket throws, e.g. when out of descriptors; an
+            // exception escaping the task would terminate the process
+            ec = e;
+        }
+        --connecting_;
+        // a woken waiter may find its host full and wait there instead, so
+        // hand the free slot to every waiter rather than to one
+        while (!connect_waiters_.empty()) {
+            wake_(connect_waiters_);
+        }
+        if (ec) {
+            --host.open;
+            wake_(host.waiters);
+            co_return ec;
+        }
+        co_return lease(this, &host, std::move(sock));
+    }
+
+    auto acquire(std::string_view hostname, uint16_t port) -> async::task<utils::expected<lease, std::error_code>> {
+        return acquire(address(hostname, port));
+    }
+
+    /*
+     * Run by maintain() on every idle connection; false closes it. Without
+     * one, only a cheap non-blocking peek detects peers that hung up.
+     */
+    auto set_health_check(health_check check) -> void {
+        check_ = std::move(check);
+    }
+
+    /*
+     * Expires and probes idle connections every check_interval until close().
+     */
+    auto maintain() -> async::task<> {
+        while (!closed_) {
+            co_await async::async_sleep(options_.check_interval);
+            // acquire() may add hosts while a probe is suspended
+            std::vector<host *> hosts;
+            for (auto &[key, host] : hosts_) {
+                hosts.push_back(&host);
+            }
+            for (auto *host : hosts) {
+                if (closed_) {
+                    break;
+                }
+                co_await check_host_(*host);
+            }
+        }
+    }
+
+    /*
+     * Drops idle connections and stops maintain(); leases stay valid.
+     */
+    auto close() -> void {
+        closed_ = true;
+        for (auto &[key, host] : hosts_) {
+            host.open -= host.idle.size();
+            host.idle.clear();
+        }
+    }
+
+    auto open_count() const -> std::size_t {
+        std::size_t count = 0;
+        for (auto const &[key, host] : hosts_) {
+            count += host.open;
+        }
+        return count;
+    }
+
+    auto idle_count() const -> std::size_t {
+        std::size_t count = 0;
+        for (auto const &[key, host] : hosts_) {
+            count += host.idle.size();
+        }
+        return count;
+    }
+
+private:
+    auto host_(address const &addr) -> host & {
+        auto [it, inserted] = hosts_.try_emplace(fmt::format("{}", addr));
+        if (inserted) {
+            it->second.addr = addr;
+        }
+        return it->second;
+    }
+
+    auto release_(host &host, socket<Protocol> &&sock, bool reusable) -> void {
+        if (reusable && !closed_ && host.idle.size() < options_.max_idle_per_host) {
+            host.idle.push_back({std::move(sock), async::default_scheduler().now()});
+        }
+        else {
+            --host.open;
+        }
+        wake_(host.waiters);
+    }
+
+    /*
+     * Resumes one waiter from the scheduler rather than from inside the
+     * releasing coroutine.
+     */
+    auto wake_(std::deque<std::coroutine_handle<>> &waiters) -> void {
+        if (!waiters.empty()) {
+            auto &scheduler = async::default_scheduler();
+            scheduler.post_coro(scheduler.now(), waiters.front());
+            waiters.pop_front();
+        }
+    }
+
+    /*
+     * An idle connection must have nothing to read: EOF means the peer
+     * closed it, and unsolicited bytes mean the protocol state is unknown.
+     */
+    auto alive_(socket<Protocol> &sock) -> bool {
+        char c;
+        auto res = ::recv(sock.descriptor(), &c, 1, MSG_PEEK | MSG_DONTWAIT);
+        return res == -1 && (errno == EAGAIN || errno == EWOULDBLOCK);
+    }
+
+    auto check_host_(host &host) -> async::task<> {
+        auto now = async::default_scheduler().now();
+        // take them out so that acquire() cannot lease one mid-probe
+        auto idle = std::move(host.idle);
+        host.idle.clear();
+        for (auto &entry : idle) {
+            bool keep = now - entry.since < options_.idle_timeout && alive_(entry.sock);
+            if (keep && check_) {
+                keep = co_await check_(entry.sock);
+            }
+            if (keep && !closed_ && host.idle.size() < options_.max_idle_per_host) {
+                host.idle.push_back(std::move(entry));
+            }
+            else {
+                --host.open;
+            }
+            wake_(host.waiters);
+        }
+    }
+
+private:
+    client_pool_options options_;
+    std::unordered_map<std::string, host> hosts_;
+    std::deque<std::coroutine_handle<>> connect_waiters_;
+    std::size_t connecting_ {0};
+    health_check check_;
+    bool closed_ {false};
+};
+
+} /* namespace bc::network */
+
+#endif /* __BC_NETWORK_CLIENT_POOL_H__ */
@@ -5,7 +5,13 @@
 
 #include "address.hpp"
 #include "socket.hpp"
+#include "buffer_pool.hpp"
+#include "buffered_stream.hpp"
+#include "sendfile.hpp"
+#include "shm.hpp"
 #include "server.hpp"
 #include "client.hpp"
+#include "client_pool.hpp"
+#include "zerocopy.hpp"
 
 #endif /* __BC_NETWORK_H__ */
@@ -0,0 +1,202 @@
+#pragma once
+
+#ifndef __BC_NETWORK_SENDFILE_H__
+#define __BC_NETWORK_SENDFILE_H__
+
+#include <fcntl.h>
+#include <sys/sendfile.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <coroutine>
+#include <cstddef>
+#include <cstring>
+#include <optional>
+#include <system_error>
+
+#include <bc/utils/error.hpp>
+#include <bc/utils/expected.hpp>
+#include <bc/async/file.hpp>
+#include <bc/async/scheduler.hpp>
+#include <bc/async/trace.hpp>
+#include <bc/log/log.hpp>
+
+#include "socket.hpp"
+
+namespace bc::network {
+
+namespace detail {
+
+/*
+ * Moves a file range to a socket inside the kernel, resuming on WRITE
+ * readiness until the whole range is sent or the file ends. sendfile is used
+ * when the file supports it; otherwise, or when asked, data goes file -> pipe
+ * -> socket with splice, which still never enters user space. A pipe or
+ * socket source is read from where it stands, offset ignored, and an empty
+ * one is waited on for READ rather than the socket for WRITE.
+ */
+template <protocol proto>
+class async_sendfile_awaiter {
+    constexpr static std::size_t s_chunk = 1 << 20;
+
+public:
+    async_sendfile_awaiter(socket<proto> &sock, int fd, off_t offset, std::size_t length, bool splice)
+        : sock_(sock), fd_(fd), offset_(offset), remaining_(length), splice_(splice) {}
+    async_sendfile_awaiter(async_sendfile_awaiter const &) = delete;
+    ~async_sendfile_awaiter() {
+        for (auto fd : pipe_) {
+            if (fd != -1) {
+                ::close(fd);
+            }
+        }
+    }
+
+    auto await_ready() -> bool {
+        return step_();
+    }
+
+    auto await_suspend(std::coroutine_handle<> handle) noexcept {
+        async::trace::instant("suspend_sendfile", sock_.descriptor(), handle.address(), "done", done_);
+        wait_(handle);
+        return true;
+    }
+
+    auto await_resume() noexcept -> utils::expected<std::size_t, std::error_code> {
+        if (error_) {
+            return *error_;
+        }
+        return done_;
+    }
+
+private:
+    /*
+     * Waits on whichever side blocked the last step; level-triggered
+     * readiness of the other would only spin.
+     */
+    auto wait_(std::coroutine_handle<> next) -> void {
+        bool source = source_blocked_;
+        auto fd = source ? fd_ : sock_.descriptor();
+        auto events = (source ? async::READ : async::WRITE) | async::ERROR | async::HANGUP;
+        async::default_scheduler().post_coro(fd, events, revent_, [this, next, source] {
+            if (!step_()) {
+                if (source_blocked_ == source) {
+                    return false;
+                }
+                wait_(next);
+                return true;
+            }
+            next.resume();
+            return true;
+        });
+    }
+
+    /*
+     * Returns false when the socket or the source would block with work
+     * outstanding.
+     */
+    auto step_() -> bool {
+        while (remaining_ || buffered_) {
+            auto res = splice_ ? splice_step_() : sendfile_step_();
+            if (res == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno == EAGAIN) {
+                    return false;
+                }
+                if (splice_ && errno == ESPIPE && seekable_) {
+                    seekable_ = false;
+                    continue;
+                }
+                if (!splice_ && (errno == EINVAL || errno == ENOSYS || errno == ESPIPE)) {
+                    log::debug("sendfile unsupported, falling back to splice, fd: {}", fd_);
+                    splice_ = true;
+                    continue;
+                }
+                log::error("failed to send file, fd: {}, errno: {}, message: {}", sock_.descriptor(), errno, ::strerror(errno));
+                error_ = utils::trans_error_code(errno == EPIPE ? utils::detail::closed_by_peer : errno);
+                return true;
+            }
+            if (res == 0) {
+                /* the file ended before the range did */
+                break;
+            }
+        }
+        return true;
+    }
+
+    auto sendfile_step_() -> ssize_t {
+        auto res = ::sendfile(sock_.descriptor(), fd_, &offset_, std::min(remaining_, s_chunk));
+        if (res > 0) {
+            remaining_ -= res;
+            done_ += res;
+        }
+        return res;
+    }
+
+    /*
+     * Drains what the pipe holds before pulling more of the file into it.
+     */
+    auto splice_step_() -> ssize_t {
+        if (pipe_[0] == -1 && ::pipe2(pipe_, O_NONBLOCK | O_CLOEXEC) == -1) {
+            return -1;
+        }
+        if (!buffered_) {
+            auto res = ::splice(fd_, seekable_ ? &offset_ : nullptr, pipe_[1], nullptr, std::min(remaining_, s_chunk), SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            source_blocked_ = res == -1 && errno == EAGAIN;
+            if (res <= 0) {
+                return res;
+            }
+            remaining_ -= res;
+            buffered_ = res;
+        }
+        auto res = ::splice(pipe_[0], nullptr, sock_.descriptor(), nullptr, buffered_, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if (res > 0) {
+            buffered_ -= res;
+            done_ += res;
+        }
+        return res;
+    }
+
+private:
+    socket<proto> &sock_;
+    int fd_;
+    off_t offset_;
+    std::size_t remaining_;
+    bool splice_;
+    bool seekable_ {true};
+    bool source_blocked_ {false};
+    int pipe_[2] {-1, -1};
+    std::size_t buffered_ {0};
+    std::size_t done_ {0};
+    std::optional<std::error_code> error_;
+    async::event revent_ {async::NONE};
+};
+
+} /* namespace bc::network::detail */
+
+/*
+ * Resumes with the number of bytes sent, short only if the file is.
+ */
+template <protocol proto>
+inline auto async_sendfile(socket<proto> &sock, int fd, off_t offset, std::size_t length) -> detail::async_sendfile_awaiter<proto> {
+    return {sock, fd, offset, length, false};
+}
+
+template <protocol proto>
+inline auto async_sendfile(socket<proto> &sock, async::file const &file, off_t offset, std::size_t length) -> detail::async_sendfile_awaiter<proto> {
+    return {sock, file.descriptor(), offset, length, false};
+}
+
+/*
+ * Always goes through a pipe, for sources sendfile refuses.
+ */
+template <protocol proto>
+inline auto async_splice(socket<proto> &sock, int fd, off_t offset, std::size_t length) -> detail::async_sendfile_awaiter<proto> {
+    return {sock, fd, offset, length, true};
+}
+
+} /* namespace bc::network */
+
+#endif /* __BC_NETWORK_SENDFILE_H__ */
@@ -3,79 +3,666 @@
 #ifndef __BC_NETWORK_SERVER_H__
 #define __BC_NETWORK_SERVER_H__
 
+#include <linux/filter.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <coroutine>
 #include <cstdint>
+#include <cstring>
+#include <deque>
 #include <functional>
-#include <list>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
 
+#include <bc/utils/error.hpp>
 #include <bc/utils/noncopyable.hpp>
+#include <bc/async/reactor.hpp>
+#include <bc/async/sleep.hpp>
 #include <bc/async/task.hpp>
 
 #include "socket.hpp"
 
 namespace bc::network {
 
-template <protocol Protocol, domain Domain>
-class server : private utils::noncopyable {
-    constexpr static std::size_t s_backlog = 100;
+enum class overload_policy {
+    /* stop accepting; the kernel backlog holds new connections */
+    PAUSE,
+    /* accept and reset excess connections at once */
+    REJECT,
+};
+
+struct server_stats {
+    std::size_t live;
+    std::size_t rejected;
+    std::size_t completed;
+};
+
+enum class accept_mode {
+    /* one acceptor on the calling thread hands sockets to the reactors */
+    DISPATCH,
+    /* one SO_REUSEPORT listener per reactor; the kernel balances connections */
+    REUSE_PORT,
+    /* one listener shared by all reactors, each waiting with EPOLLEXCLUSIVE */
+    EXCLUSIVE,
+};
+
+namespace detail {
+
+/*
+ * Closes with a reset instead of a graceful shutdown, so a rejected peer
+ * learns at once and the socket skips TIME_WAIT.
+ */
+template <protocol Protocol>
+inline auto reset_connection(socket<Protocol> &&sock) -> void {
+    linger abort {.l_onoff = 1, .l_linger = 0};
+    ::setsockopt(sock.descriptor(), SOL_SOCKET, SO_LINGER, &abort, sizeof(abort));
+    auto dropped = std::move(sock);
+}
 
-    struct client {
+/*
+ * A socket file left by a previous run would fail the bind.
+ */
+inline auto remove_stale_socket(address const &addr) -> void {
+    if (auto path = addr.path(); !path.empty() && path[0] != '@') {
+        struct stat st;
+        if (::stat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+            ::unlink(path.c_str());
+        }
+    }
+}
+
+/*
+ * Sessions of one scheduler in a slab: a slot is found through the free list
+ * and released by the session itself the moment it finishes, closing its
+ * socket. The finished frame cannot free itself while running, so it waits
+ * in zombie_ until the next release. Counters are atomic for stats() from
+ * other threads; everything else belongs to the owning scheduler.
+ */
+template <protocol Protocol>
+class session_registry : private utils::noncopyable {
+    struct session {
         socket<Protocol> sock;
         async::task<> task;
+        bool attached {false};
+        bool finished {false};
+    };
+
+    class slot_awaiter {
+    public:
+        slot_awaiter(session_registry &registry) : registry_(registry) {}
+
+        auto await_ready() noexcept -> bool { return !registry_.full(); }
+        auto await_suspend(std::coroutine_handle<> handle) noexcept -> void {
+            registry_.waiter_ = handle;
+        }
+        auto await_resume() noexcept -> void {}
+
+    private:
+        session_registry &registry_;
     };
 
 public:
-    server(std::string_view hostname, uint16_t port) : address_(hostname, port) {}
+    using handler = std::function<auto (socket<Protocol> &) -> async::task<>>;
+
+    constexpr static std::size_t s_unlimited = std::numeric_limits<std::size_t>::max();
+
+    /*
+     * max may be 0, for a reactor whose share of a small cap is nothing.
+     */
+    session_registry(handler const &handler, std::size_t max, std::atomic_size_t *load = nullptr) : handler_(handler), max_(max), load_(load) {}
+
+    auto full() const -> bool { return live() >= max_; }
+    auto room() const -> std::size_t { return max_ - std::min(max_, live()); }
+
+    /*
+     * Resumes once a session has finished and room is available.
+     */
+    auto wait_slot() -> slot_awaiter { return {*this}; }
+
+    auto add(socket<Protocol> &&sock) -> void {
+        std::size_t index;
+        if (free_.empty()) {
+            index = slots_.size();
+            slots_.emplace_back();
+        }
+        else {
+            index = free_.back();
+            free_.pop_back();
+        }
+        slots_[index].emplace(std::move(sock));
+        live_.fetch_add(1, std::memory_order_relaxed);
+        auto task = run_(index);
+        if (slots_[index]->finished) {
+            // finished without suspending; the frame is not running anymore
+            slots_[index].reset();
+            free_.push_back(index);
+            return;
+        }
+        slots_[index]->task = std::move(task);
+        slots_[index]->attached = true;
+    }
+
+    auto reject(socket<Protocol> &&sock) -> void {
+        reset_connection(std::move(sock));
+        rejected_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    auto live() const -> std::size_t { return live_.load(std::memory_order_relaxed); }
+    auto rejected() const -> std::size_t { return rejected_.load(std::memory_order_relaxed); }
+    auto completed() const -> std::size_t { return completed_.load(std::memory_order_relaxed); }
+
+private:
+    auto run_(std::size_t index) -> async::task<> {
+        {
+            auto session = handler_(slots_[index]->sock);
+            while (!session.done()) {
+                co_await session;
+            }
+        }
+        if (load_) {
+            --*load_;
+        }
+        release_(index);
+    }
+
+    auto release_(std::size_t index) -> void {
+        live_.fetch_sub(1, std::memory_order_relaxed);
+        completed_.fetch_add(1, std::memory_order_relaxed);
+        auto &slot = slots_[index];
+        if (!slot->attached) {
+            slot->finished = true;
+            return;
+        }
+        // the previous zombie has long reached its final suspend point
+        zombie_.reset();
+        zombie_.emplace(std::move(slot->task));
+        slot.reset();
+        free_.push_back(index);
+        if (waiter_ && !full()) {
+            auto &scheduler = async::default_scheduler();
+            scheduler.post_coro(scheduler.now(), std::exchange(waiter_, nullptr));
+        }
+    }
+
+private:
+    handler const &handler_;
+    std::size_t max_;
+    std::atomic_size_t *load_;
+    // a deque keeps sessions in place as it grows, sockets are lent by reference
+    std::deque<std::optional<session>> slots_;
+    std::vector<std::size_t> free_;
+    std::optional<async::task<>> zombie_;
+    std::coroutine_handle<> waiter_;
+    std::atomic_size_t live_ {0};
+    std::atomic_size_t rejected_ {0};
+    std::atomic_size_t completed_ {0};
+};
+
+} /* namespace bc::network::detail */
+
+template <protocol Protocol, domain Domain>
+class server : private utils::noncopyable {
+    /* the kernel caps it at net.core.somaxconn */
+    constexpr static std::size_t s_default_backlog = 4096;
+    /* connections taken from the accept queue per wakeup */
+    constexpr static std::size_t s_accept_budget = 64;
+    /* how often a paused dispatching acceptor looks at the reactors again */
+    constexpr static std::chrono::milliseconds s_pause_recheck {10};
+    /* how long an accept loop waits after a failed accept, e.g. out of descriptors */
+    constexpr static std::chrono::milliseconds s_accept_backoff {100};
+    /* the data sent along with the listeners on a handoff */
+    constexpr static std::string_view s_handoff_tag = "bc-listeners";
+
+    using registry = detail::session_registry<Protocol>;
+
+public:
+    server(std::string_view hostname, uint16_t port, std::size_t backlog = s_default_backlog) : address_(hostname, port), backlog_(backlog) {}
+    /*
+     * Any address, e.g. address::from_path() for a Unix domain server.
+     */
+    server(address addr, std::size_t backlog = s_default_backlog) : address_(std::move(addr)), backlog_(backlog) {}
+
+    /*
+     * Caps live sessions; must be called before start(). With a pool each
+     * reactor takes an equal share, the first max % size one more, except in
+     * dispatch mode where the cap holds for the sum. With REUSE_PORT and
+     * PAUSE, a reactor left with no share never accepts what the kernel
+     * hashes to its listener, so keep max at least the pool size there.
+     */
+    auto set_max_connections(std::size_t max, overload_policy policy = overload_policy::PAUSE) -> void {
+        max_connections_ = max;
+        policy_ = policy;
+    }
 
     template <typename F>
     auto start(F &&f) -> void {
         handler_ = std::forward<F>(f);
+        local_ = std::make_unique<registry>(handler_, max_connections_ ? max_connections_ : registry::s_unlimited);
         task_ = std::move(run_());
     }
 
+    /*
+     * Dispatch mode: accepting stays on the calling thread's scheduler and
+     * every accepted socket is handed to the least-loaded reactor of the pool,
+     * where its session coroutine starts. The pool must be stopped before the
+     * server is destroyed.
+     *
+     * In the other modes every reactor accepts for itself and its sessions
+     * stay there, so the handshake rate scales with the pool and the calling
+     * thread is left free. REUSE_PORT leaves the choice of reactor to the
+     * kernel's hash, or to the steering program if one is set; EXCLUSIVE
+     * hands a connection to whichever idle reactor epoll wakes first.
+     */
+    template <typename F>
+    auto start(async::reactor_pool &pool, F &&f, accept_mode mode = accept_mode::DISPATCH) -> void {
+        pool_ = &pool;
+        handler_ = std::forward<F>(f);
+        // shares sum to the cap exactly
+        bool capped = mode != accept_mode::DISPATCH && max_connections_;
+        auto share = max_connections_ / pool.size();
+        auto extra = max_connections_ % pool.size();
+        if (capped && mode == accept_mode::REUSE_PORT && policy_ == overload_policy::PAUSE && share == 0) {
+            log::warning("{} of {} reactors get no connections, their listeners will not be served", pool.size() - extra, pool.size());
+        }
+        for (std::size_t i = 0; i < pool.size(); ++i) {
+            auto max = capped ? share + (i < extra) : registry::s_unlimited;
+            registries_.push_back(std::make_unique<registry>(handler_, max, &pool[i].sessions()));
+        }
+        if (mode == accept_mode::DISPATCH) {
+            task_ = std::move(run_());
+            return;
+        }
+        mode_ = mode;
+        if (mode == accept_mode::EXCLUSIVE) {
+            listen_(shared_, false);
+            acceptors_.resize(pool.size());
+            for (std::size_t i = 0; i < pool.size(); ++i) {
+                pool[i].post([this, i] {
+                    acceptors_[i] = std::move(run_local_(i, shared_, async::READ | async::EXCLUSIVE));
+                });
+            }
+            return;
+        }
+        // bind in reactor order so that group indexes match the pool's; a
+        // larger group inherited from a previous process is spread over the
+        // reactors so that no member's backlog is left unserved
+        auto count = std::max(pool.size(), inherited_.size());
+        bool inherited = !inherited_.empty();
+        listeners_.reserve(count);
+        for (std::size_t i = 0; i < count; ++i) {
+            listeners_.emplace_back();
+            listen_(listeners_.back(), true);
+        }
+        if (!steering_.empty() && !inherited) {
+            listeners_.front().attach_reuseport_filter(steering_);
+        }
+        acceptors_.resize(count);
+        for (std::size_t i = 0; i < count; ++i) {
+            pool[i % pool.size()].post([this, i, reactor=i % pool.size()] {
+                acceptors_[i] = std::move(run_local_(reactor, listeners_[i], async::READ));
+            });
+        }
+    }
+
+    /*
+     * Classic BPF program choosing the REUSE_PORT listener of a connection;
+     * must be set before start().
+     */
+    auto set_steering(std::vector<sock_filter> program) -> void {
+        steering_ = std::move(program);
+    }
+
+    /*
+     * Steers each connection to the listener whose index is the cpu that
+     * received it, keeping the handshake and the session on that cpu. Only
+     * meaningful when reactor i is pinned to cpu i.
+     */
+    auto steer_by_cpu() -> void {
+        set_steering({
+            BPF_STMT(BPF_LD | BPF_W | BPF_ABS, static_cast<std::uint32_t>(SKF_AD_OFF + SKF_AD_CPU)),
+            BPF_STMT(BPF_RET | BPF_A, 0),
+        });
+    }
+
+    /*
+     * Defaults for listening sockets (role::SERVER), applied before listen()
+     * so that buffer sizes are inherited by accepted sockets and the window
+     * scale is negotiated from them, and for every accepted socket
+     * (role::PEER), applied on the thread that will run its session. Must be
+     * set before start().
+     */
+    auto set_socket_options(role r, socket_options options) -> void {
+        assert(r != role::UNDETERMINED);
+        (r == role::SERVER ? listener_options_ : peer_options_) = std::move(options);
+    }
+
+    auto stats() const -> server_stats {
+        server_stats stats {0, rejected_.load(std::memory_order_relaxed), 0};
+        auto add = [&](registry const &r) {
+            stats.live += r.live();
+            stats.rejected += r.rejected();
+            stats.completed += r.completed();
+        };
+        if (local_) {
+            add(*local_);
+        }
+        for (auto const &r : registries_) {
+            add(*r);
+        }
+        return stats;
+    }
+
+    /*
+     * Stops accepting for good, while live sessions run to completion; stats()
+     * tells when they are done. Must be called on the thread that called
+     * start(). The listeners stay open until the server is destroyed, so
+     * connections still queued on them wait for whoever else holds them.
+     */
+    auto drain() -> void {
+        if (draining_.exchange(true)) {
+            return;
+        }
+        log::info("draining, live sessions: {}", stats().live);
+        if (acceptors_.empty()) {
+            async::default_scheduler().cancel(primary_.descriptor());
+            return;
+        }
+        for (std::size_t i = 0; i < pool_->size(); ++i) {
+            (*pool_)[i].post([this, i] {
+                auto &scheduler = async::default_scheduler();
+                if (mode_ == accept_mode::EXCLUSIVE) {
+                    scheduler.cancel(shared_.descriptor());
+                    return;
+                }
+                for (std::size_t j = i; j < listeners_.size(); j += pool_->size()) {
+                    scheduler.cancel(listeners_[j].descriptor());
+                }
+            });
+        }
+    }
+
+    auto draining() const -> bool { return draining_.load(std::memory_order_relaxed); }
+
+    /*
+     * Hot restart, old side: waits on addr, a Unix domain address, for the
+     * next process to call inherit(), passes it the listening sockets and
+     * drains. Runs on the calling thread's scheduler; call after start().
+     */
+    auto serve_handoff(address addr) -> void {
+        handoff_ = std::move(handoff_run_(std::move(addr)));
+    }
+
+    /*
+     * Hot restart, new side: takes the listening sockets of the server
+     * waiting in serve_handoff() on addr, instead of binding new ones, so
+     * the ports never close and their backlogs carry over. Blocks for at
+     * most timeout; call before start(), in the accept mode the old server
+     * used.
+     */
+    auto inherit(address const &addr, std::chrono::milliseconds timeout = std::chrono::seconds(5)) -> std::error_code {
+        int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd == -1) {
+            log::error("failed to create handoff socket, errno: {}, message: {}", errno, ::strerror(errno));
+            return utils::trans_error_code(errno);
+        }
+        // a blocking exchange, as there is nothing to serve yet
+        auto control = socket<protocol::TCP>::wrap(fd, domain::UNIX, role::PEER);
+        timeval tv {
+            .tv_sec = static_cast<time_t>(timeout.count() / 1000),
+            .tv_usec = static_cast<suseconds_t>(timeout.count() % 1000 * 1000),
+        };
+        ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        if (::connect(fd, addr.sockaddr(), addr.socklen()) == -1) {
+            // the usual cold start
+            auto ec = utils::trans_error_code(errno);
+            log::info("no previous server at {}, message: {}", addr, ec.message());
+            return ec;
+        }
+        char tag[s_handoff_tag.size()];
+        auto res = control.read_with_descriptors(tag);
+        if (!res) {
+            return utils::would_block(res.error()) ? utils::trans_error_code(utils::detail::timed_out) : res.error();
+        }
+        std::vector<socket<Protocol>> listeners;
+        for (int received : res->fds) {
+            listeners.push_back(socket<Protocol>::wrap(received, address_.domain(), role::SERVER));
+        }
+        if (std::string_view(tag, res->bytes) != s_handoff_tag) {
+            log::error("unexpected handoff from {}", addr);
+            return utils::trans_error_code(utils::detail::bad_message);
+        }
+        for (auto &listener : listeners) {
+            int listening = 0;
+            socklen_t len = sizeof(listening);
+            if (::getsockopt(listener.descriptor(), SOL_SOCKET, SO_ACCEPTCONN, &listening, &len) == -1 || !listening) {
+                log::error("handed a socket that is not listening, fd: {}", listener.descriptor());
+                return utils::trans_error_code(utils::detail::invalid_argument);
+            }
+        }
+        log::info("inherited {} listeners from {}", listeners.size(), addr);
+        inherited_ = std::move(listeners);
+        return {};
+    }
+
 private:
+    /*
+     * The calling thread's accept loop, serving sessions itself or
+     * dispatching them to the pool.
+     */
     auto run_() -> async::task<> {
-        socket<Protocol> sock;
-        sock.listen(address_, s_backlog);
-        while (true) {
-            auto res = co_await async_accept(sock);
-            if (res) {
-                add_client_(*std::move(res));
+        auto &sock = primary_;
+        listen_(sock, false);
+        if (!inherited_.empty()) {
+            log::warning("{} inherited listeners left unserved in this accept mode", inherited_.size());
+        }
+        while (!draining_) {
+            auto room = pool_ ? dispatch_room_() : local_->room();
+            if (room == 0 && policy_ == overload_policy::PAUSE) {
+                if (pool_) {
+                    co_await async::async_sleep(s_pause_recheck);
+                }
+                else {
+                    co_await local_->wait_slot();
+                }
+                continue;
             }
-            else {
-                log::error("unexpected error, message: {}", res.error().message());
-                break;
+            auto budget = policy_ == overload_policy::PAUSE ? std::min(room, s_accept_budget) : s_accept_budget;
+            auto res = co_await async_accept_many(sock, budget);
+            if (!res) {
+                if (stopped_(sock, res.error())) {
+                    break;
+                }
+                co_await async::async_sleep(s_accept_backoff);
+                continue;
             }
-            auto it = clients_.begin();
-            while (it != clients_.end()) {
-                if (it->task.done()) {
-                    clients_.erase(it++);
-                    log::info("remove a client\n");
+            for (auto &[client_sock, peer] : *res) {
+                log::debug("accepted connection from {}", peer);
+                if (pool_) {
+                    dispatch_(std::move(client_sock), room);
+                }
+                else if (local_->full()) {
+                    local_->reject(std::move(client_sock));
                 }
                 else {
-                    log::info("has clients: {}\n", clients_.size());
-                    ++it;
+                    tune_(client_sock);
+                    local_->add(std::move(client_sock));
+                }
+            }
+        }
+    }
+
+    /*
+     * Accept loop of reactor index on listener, run on that reactor's thread.
+     */
+    auto run_local_(std::size_t index, socket<Protocol> &listener, async::event e) -> async::task<> {
+        auto &reactor = (*pool_)[index];
+        auto &sessions = *registries_[index];
+        while (!draining_.load(std::memory_order_relaxed)) {
+            if (sessions.full() && policy_ == overload_policy::PAUSE) {
+                // with EXCLUSIVE the other reactors keep accepting meanwhile
+                co_await sessions.wait_slot();
+                continue;
+            }
+            auto budget = policy_ == overload_policy::PAUSE ? std::min(sessions.room(), s_accept_budget) : s_accept_budget;
+            auto res = co_await async_accept_many(listener, budget, e);
+            if (!res) {
+                if (stopped_(listener, res.error())) {
+                    break;
+                }
+                co_await async::async_sleep(s_accept_backoff);
+                continue;
+            }
+            for (auto &[client_sock, peer] : *res) {
+                log::debug("accepted connection from {}", peer);
+                if (sessions.full()) {
+                    sessions.reject(std::move(client_sock));
+                    continue;
                 }
+                ++reactor.sessions();
+                tune_(client_sock);
+                sessions.add(std::move(client_sock));
+            }
+        }
+    }
+
+    auto listen_(socket<Protocol> &sock, bool reuse_port) -> void {
+        if (!inherited_.empty()) {
+            // already bound, tuned and listening
+            sock = std::move(inherited_.front());
+            inherited_.erase(inherited_.begin());
+            return;
+        }
+        if (!reuse_port) {
+            detail::remove_stale_socket(address_);
+        }
+        sock.bind(address_, reuse_port);
+        if (auto ec = sock.apply(listener_options_)) {
+            log::warning("failed to apply listener options, message: {}", ec.message());
+        }
+        sock.listen(backlog_);
+    }
+
+    /*
+     * A peer that is already gone fails here too, so failures are only
+     * logged; its session will see the error on first I/O.
+     */
+    auto tune_(socket<Protocol> &sock) -> void {
+        if (auto ec = sock.apply(peer_options_)) {
+            log::debug("failed to apply peer options, fd: {}, message: {}", sock.descriptor(), ec.message());
+        }
+    }
+
+    /*
+     * Only a cancel ends an accept loop. Other failures, such as running out
+     * of descriptors or memory, usually pass once sessions finish, so the
+     * loop backs off and accepts again.
+     */
+    auto stopped_(socket<Protocol> const &listener, std::error_code const &ec) -> bool {
+        if (ec == utils::trans_error_code(utils::detail::operation_canceled)) {
+            log::info("stopped accepting, fd: {}", listener.descriptor());
+            return true;
+        }
+        log::warning("accept failed, fd: {}, retrying in {}ms, message: {}", listener.descriptor(), s_accept_backoff.count(), ec.message());
+        return false;
+    }
+
+    auto handoff_run_(address addr) -> async::task<> {
+        while (true) {
+            std::optional<socket<protocol::TCP>> control(std::in_place);
+            detail::remove_stale_socket(addr);
+            control->listen(addr, 1);
+            auto peer = co_await async_accept(*control);
+            if (!peer) {
+                log::error("handoff stopped, message: {}", peer.error().message());
+                co_return;
+            }
+            // free addr before the next process, which serves it in turn
+            control.reset();
+            std::vector<int> fds;
+            if (primary_.descriptor()) {
+                fds.push_back(primary_.descriptor());
+            }
+            if (shared_.descriptor()) {
+                fds.push_back(shared_.descriptor());
+            }
+            for (auto const &listener : listeners_) {
+                fds.push_back(listener.descriptor());
             }
+            auto sent = co_await async_write_with_descriptors(*peer, s_handoff_tag, fds);
+            if (!sent) {
+                log::error("failed to hand off listeners, message: {}", sent.error().message());
+                continue;
+            }
+            log::info("handed off {} listeners", fds.size());
+            drain();
+            co_return;
         }
     }
 
-    auto add_client_(socket<Protocol> &&client_sock) -> void {
-        clients_.emplace_back(std::move(client_sock));
-        clients_.back().task = std::move(async_session_(clients_.back().sock));
+    auto dispatch_room_() const -> std::size_t {
+        if (!max_connections_) {
+            return std::numeric_limits<std::size_t>::max();
+        }
+        // reactor counters include sockets handed off but not registered yet
+        std::size_t live = 0;
+        for (std::size_t i = 0; i < pool_->size(); ++i) {
+            live += (*pool_)[i].sessions().load(std::memory_order_relaxed);
+        }
+        return max_connections_ - std::min(max_connections_, live);
     }
 
-    auto async_session_(socket<Protocol> &client_sock) -> async::task<> {
-        auto session = handler_(client_sock);
-        while (!session.done()) {
-            co_await session;
+    auto dispatch_(socket<Protocol> &&client_sock, std::size_t &room) -> void {
+        if (room == 0) {
+            detail::reset_connection(std::move(client_sock));
+            rejected_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        if (room != std::numeric_limits<std::size_t>::max()) {
+            --room;
         }
+        auto index = pool_->least_loaded();
+        auto &reactor = (*pool_)[index];
+        // counted at handoff so that back-to-back accepts already see it
+        ++reactor.sessions();
+        reactor.post([this, index, client_sock = std::move(client_sock)] mutable {
+            tune_(client_sock);
+            registries_[index]->add(std::move(client_sock));
+        });
     }
 
 private:
     address address_;
+    std::size_t backlog_;
     std::function<auto (socket<Protocol> &) -> async::task<>> handler_;
     async::task<> task_;
-    std::list<client> clients_;
+    std::size_t max_connections_ {0};
+    overload_policy policy_ {overload_policy::PAUSE};
+    socket_options listener_options_;
+    socket_options peer_options_;
+    std::unique_ptr<registry> local_;
+    std::vector<std::unique_ptr<registry>> registries_;
+    std::atomic_size_t rejected_ {0};
+    async::reactor_pool *pool_ {nullptr};
+    accept_mode mode_ {accept_mode::DISPATCH};
+    std::vector<async::task<>> acceptors_;
+    socket<Protocol> primary_;
+    std::vector<socket<Protocol>> listeners_;
+    socket<Protocol> shared_;
+    std::vector<socket<Protocol>> inherited_;
+    std::vector<sock_filter> steering_;
+    std::atomic_bool draining_ {false};
+    async::task<> handoff_;
 };
 
 } /* namespace bc::network */
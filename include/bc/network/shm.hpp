@@ -0,0 +1,419 @@
+#pragma once
+
+#ifndef __BC_NETWORK_SHM_H__
+#define __BC_NETWORK_SHM_H__
+
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cassert>
+#include <cerrno>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <span>
+#include <system_error>
+#include <utility>
+
+#include <bc/utils/error.hpp>
+#include <bc/utils/expected.hpp>
+#include <bc/utils/memory.hpp>
+#include <bc/utils/noncopyable.hpp>
+#include <bc/async/scheduler.hpp>
+#include <bc/async/trace.hpp>
+#include <bc/log/log.hpp>
+
+namespace bc::network {
+
+namespace detail {
+
+/*
+ * One direction of a shm_stream. head is only written by the reader and tail
+ * only by the writer; the waiting flags and positions use seq_cst so that a
+ * side about to sleep and the side making progress cannot both miss each
+ * other: the sleeper publishes its flag then re-checks the position, the
+ * other side publishes the position then checks the flag.
+ */
+struct shm_ring {
+    alignas(64) std::atomic_uint64_t head {0};
+    alignas(64) std::atomic_uint64_t tail {0};
+    alignas(64) std::atomic_uint32_t reader_waiting {0};
+    std::atomic_uint32_t writer_waiting {0};
+    std::atomic_uint32_t reader_closed {0};
+    std::atomic_uint32_t writer_closed {0};
+    std::uint64_t capacity {0};
+
+    auto data() -> char * { return reinterpret_cast<char *>(this + 1); }
+};
+
+static_assert(std::atomic_uint64_t::is_always_lock_free && std::atomic_uint32_t::is_always_lock_free);
+
+template <typename Op>
+class shm_io_awaiter;
+
+} /* namespace bc::network::detail */
+
+/*
+ * Descriptors another process needs to attach to the same channel, to be
+ * inherited or sent over a Unix socket. side tells which end it becomes.
+ */
+struct shm_descriptors {
+    int memory {-1};
+    std::array<int, 2> data {-1, -1};
+    std::array<int, 2> space {-1, -1};
+    int side {0};
+};
+
+/*
+ * Byte stream between two endpoints on one host over a pair of single
+ * producer, single consumer rings in a memfd. Data is copied straight into
+ * the peer-visible ring without a syscall; eventfds are only written when the
+ * other side announced it is about to sleep. Reads and writes have the same
+ * shape as socket's, so handlers written against async_read/async_write run
+ * over it unchanged. A peer process that dies without closing is not noticed.
+ */
+class shm_stream : private utils::noncopyable {
+    template <typename Op>
+    friend class detail::shm_io_awaiter;
+
+public:
+    constexpr static std::size_t s_default_capacity = 1 << 20;
+
+    static auto create(std::size_t capacity = s_default_capacity) -> std::pair<shm_stream, shm_stream> {
+        capacity = std::bit_ceil(std::max<std::size_t>(capacity, 4096));
+        shm_descriptors fds {.memory = ::memfd_create("bc-shm", MFD_CLOEXEC), .side = 0};
+        if (fds.memory == -1) {
+            log::error("failed to create memfd, errno: {}, message: {}", errno, ::strerror(errno));
+            throw utils::trans_error_code(errno);
+        }
+        if (::ftruncate(fds.memory, 2 * ring_size_(capacity)) == -1) {
+            log::error("failed to size memfd, errno: {}, message: {}", errno, ::strerror(errno));
+            auto ec = utils::trans_error_code(errno);
+            close_descriptors_(fds);
+            throw ec;
+        }
+        for (std::size_t i = 0; i < 2; ++i) {
+            fds.data[i] = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+            fds.space[i] = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+            if (fds.data[i] == -1 || fds.space[i] == -1) {
+                log::error("failed to create eventfd, errno: {}, message: {}", errno, ::strerror(errno));
+                auto ec = utils::trans_error_code(errno);
+                close_descriptors_(fds);
+                throw ec;
+            }
+        }
+
+        // both ends hold their own duplicates, ours go either way
+        try {
+            auto first = attach(fds);
+            for (auto *ring : first.rings_) {
+                new (ring) detail::shm_ring {.capacity = capacity};
+            }
+            fds.side = 1;
+            auto second = attach(fds);
+            close_descriptors_(fds);
+            return {std::move(first), std::move(second)};
+        }
+        catch (...) {
+            close_descriptors_(fds);
+            throw;
+        }
+    }
+
+    /*
+     * Duplicates the descriptors; the caller keeps ownership of its copies.
+     */
+    static auto attach(shm_descriptors const &fds) -> shm_stream {
+        shm_stream stream;
+        // the destructor only releases a mapped stream, so failures below close by hand
+        auto fail = [&stream](char const *what) {
+            log::error("failed to {}, errno: {}, message: {}", what, errno, ::strerror(errno));
+            auto ec = utils::trans_error_code(errno);
+            close_descriptors_({stream.memory_, stream.data_, stream.space_});
+            return ec;
+        };
+        stream.side_ = fds.side;
+        stream.memory_ = ::fcntl(fds.memory, F_DUPFD_CLOEXEC, 0);
+        for (std::size_t i = 0; i < 2; ++i) {
+            stream.data_[i] = ::fcntl(fds.data[i], F_DUPFD_CLOEXEC, 0);
+            stream.space_[i] = ::fcntl(fds.space[i], F_DUPFD_CLOEXEC, 0);
+        }
+        if (stream.memory_ == -1 || std::ranges::find(stream.data_, -1) != stream.data_.end() || std::ranges::find(stream.space_, -1) != stream.space_.end()) {
+            throw fail("duplicate shared memory descriptors");
+        }
+        struct stat st;
+        if (::fstat(stream.memory_, &st) == -1) {
+            throw fail("attach shared memory");
+        }
+        stream.length_ = st.st_size;
+        stream.base_ = ::mmap(nullptr, stream.length_, PROT_READ | PROT_WRITE, MAP_SHARED, stream.memory_, 0);
+        if (stream.base_ == MAP_FAILED) {
+            stream.base_ = nullptr;
+            throw fail("map shared memory");
+        }
+        utils::memory::add(utils::memory::category::SOCKET_BUFFERS, stream.length_);
+        auto half = stream.length_ / 2;
+        stream.rings_[0] = static_cast<detail::shm_ring *>(stream.base_);
+        stream.rings_[1] = reinterpret_cast<detail::shm_ring *>(static_cast<char *>(stream.base_) + half);
+        return stream;
+    }
+
+public:
+    shm_stream() = default;
+    shm_stream(shm_stream &&other) {
+        swap_(other);
+    }
+    auto operator=(shm_stream &&other) -> shm_stream & {
+        if (this != &other) {
+            close();
+            swap_(other);
+        }
+        return *this;
+    }
+    ~shm_stream() {
+        close();
+    }
+
+    /*
+     * Marks both directions closed, so the peer reads end of stream once the
+     * ring drains and its writes fail with broken_pipe.
+     */
+    auto close() -> void {
+        if (!base_) {
+            return;
+        }
+        outbound_().writer_closed.store(1);
+        inbound_().reader_closed.store(1);
+        signal_(data_[out_index_()]);
+        signal_(space_[in_index_()]);
+        detach();
+    }
+
+    /*
+     * Drops this process's mapping and descriptors without closing the
+     * channel, for an endpoint whose descriptors were handed to another process.
+     */
+    auto detach() -> void {
+        if (!base_) {
+            return;
+        }
+        for (auto fd : {data_[0], data_[1], space_[0], space_[1]}) {
+            async::default_scheduler().unsubscribe(fd);
+            ::close(fd);
+        }
+        ::munmap(base_, length_);
+        utils::memory::sub(utils::memory::category::SOCKET_BUFFERS, length_);
+        ::close(memory_);
+        base_ = nullptr;
+    }
+
+    /*
+     * Non-blocking; reports resource_unavailable_try_again when the ring is
+     * empty and 0 once the peer closed and everything was read.
+     */
+    auto read(std::span<char> buffer) -> utils::expected<std::size_t, std::error_code> {
+        auto &ring = inbound_();
+        auto head = ring.head.load(std::memory_order_relaxed);
+        auto tail = ring.tail.load();
+        if (head == tail) {
+            if (ring.writer_closed.load()) {
+                return 0;
+            }
+            return utils::trans_error_code(EAGAIN);
+        }
+        auto n = std::min<std::size_t>(buffer.size(), tail - head);
+        copy_out_(ring, head, buffer.data(), n);
+        ring.head.store(head + n);
+        if (ring.writer_waiting.load()) {
+            signal_(space_[in_index_()]);
+        }
+        return n;
+    }
+
+    auto write(std::span<char const> data) -> utils::expected<std::size_t, std::error_code> {
+        auto &ring = outbound_();
+        if (ring.reader_closed.load()) {
+            return utils::trans_error_code(EPIPE);
+        }
+        auto tail = ring.tail.load(std::memory_order_relaxed);
+        auto head = ring.head.load();
+        auto free = ring.capacity - (tail - head);
+        if (free == 0 && !data.empty()) {
+            return utils::trans_error_code(EAGAIN);
+        }
+        auto n = std::min<std::size_t>(data.size(), free);
+        copy_in_(ring, tail, data.data(), n);
+        ring.tail.store(tail + n);
+        if (ring.reader_waiting.load()) {
+            signal_(data_[out_index_()]);
+        }
+        return n;
+    }
+
+    auto descriptors() const -> shm_descriptors {
+        return {memory_, data_, space_, 1 - side_};
+    }
+
+private:
+    constexpr static auto ring_size_(std::size_t capacity) -> std::size_t {
+        return sizeof(detail::shm_ring) + capacity;
+    }
+
+    /*
+     * Closes whatever of fds was opened, -1 marking the rest.
+     */
+    static auto close_descriptors_(shm_descriptors const &fds) -> void {
+        for (auto fd : {fds.memory, fds.data[0], fds.data[1], fds.space[0], fds.space[1]}) {
+            if (fd != -1) {
+                ::close(fd);
+            }
+        }
+    }
+
+    static auto signal_(int fd) -> void {
+        std::uint64_t one = 1;
+        while (::write(fd, &one, sizeof(one)) == -1 && errno == EINTR) {}
+    }
+
+    static auto copy_in_(detail::shm_ring &ring, std::uint64_t pos, char const *src, std::size_t n) -> void {
+        auto offset = pos & (ring.capacity - 1);
+        auto first = std::min<std::size_t>(n, ring.capacity - offset);
+        std::memcpy(ring.data() + offset, src, first);
+        std::memcpy(ring.data(), src + first, n - first);
+    }
+
+    static auto copy_out_(detail::shm_ring &ring, std::uint64_t pos, char *dst, std::size_t n) -> void {
+        auto offset = pos & (ring.capacity - 1);
+        auto first = std::min<std::size_t>(n, ring.capacity - offset);
+        std::memcpy(dst, ring.data() + offset, first);
+        std::memcpy(dst + first, ring.data(), n - first);
+    }
+
+    auto out_index_() const -> int { return side_; }
+    auto in_index_() const -> int { return 1 - side_; }
+    auto outbound_() -> detail::shm_ring & { return *rings_[out_index_()]; }
+    auto inbound_() -> detail::shm_ring & { return *rings_[in_index_()]; }
+
+    /*
+     * Descriptor to sleep on and the flag announcing it, for a reader or a
+     * writer.
+     */
+    auto wait_fd_(bool reading) const -> int {
+        return reading ? data_[in_index_()] : space_[out_index_()];
+    }
+    auto waiting_flag_(bool reading) -> std::atomic_uint32_t & {
+        return reading ? inbound_().reader_waiting : outbound_().writer_waiting;
+    }
+
+    auto swap_(shm_stream &other) -> void {
+        std::swap(side_, other.side_);
+        std::swap(memory_, other.memory_);
+        std::swap(data_, other.data_);
+        std::swap(space_, other.space_);
+        std::swap(base_, other.base_);
+        std::swap(length_, other.length_);
+        std::swap(rings_, other.rings_);
+    }
+
+private:
+    int side_ {0};
+    int memory_ {-1};
+    std::array<int, 2> data_ {-1, -1};
+    std::array<int, 2> space_ {-1, -1};
+    void *base_ {nullptr};
+    std::size_t length_ {0};
+    std::array<detail::shm_ring *, 2> rings_ {};
+};
+
+namespace detail {
+
+/*
+ * Completes without suspending whenever the ring allows it; otherwise raises
+ * the waiting flag, re-checks, and sleeps on the eventfd the peer signals.
+ */
+template <typename Op>
+class shm_io_awaiter {
+public:
+    shm_io_awaiter(shm_stream &stream, bool reading, Op op) : stream_(stream), reading_(reading), op_(std::move(op)) {}
+
+    auto await_ready() -> bool {
+        res_ = op_(stream_);
+        if (res_ || !utils::would_block(res_.error())) {
+            return true;
+        }
+        stream_.waiting_flag_(reading_).store(1);
+        res_ = op_(stream_);
+        if (res_ || !utils::would_block(res_.error())) {
+            stream_.waiting_flag_(reading_).store(0);
+            return true;
+        }
+        return false;
+    }
+
+    auto await_suspend(std::coroutine_handle<> handle) noexcept {
+        auto fd = stream_.wait_fd_(reading_);
+        async::trace::instant(reading_ ? "suspend_shm_read" : "suspend_shm_write", fd, handle.address());
+        async::default_scheduler().post_coro(fd, async::READ, revent_, [this, fd, next=handle] {
+            std::uint64_t count;
+            while (::read(fd, &count, sizeof(count)) == -1 && errno == EINTR) {}
+            auto res = op_(stream_);
+            if (!res && utils::would_block(res.error())) {
+                return false;
+            }
+            stream_.waiting_flag_(reading_).store(0);
+            res_ = std::move(res);
+            next.resume();
+            return true;
+        });
+        return true;
+    }
+
+    auto await_resume() noexcept -> utils::expected<std::size_t, std::error_code> {
+        return std::move(res_);
+    }
+
+private:
+    shm_stream &stream_;
+    bool reading_;
+    Op op_;
+    async::event revent_ {async::NONE};
+    utils::expected<std::size_t, std::error_code> res_;
+};
+
+} /* namespace bc::network::detail */
+
+/*
+ * Like the socket overloads, end of stream and a closed reader surface as
+ * closed_by_peer.
+ */
+inline auto async_read(shm_stream &stream, std::span<char> buffer) {
+    return detail::shm_io_awaiter(stream, true, [buffer](shm_stream &stream) -> utils::expected<std::size_t, std::error_code> {
+        auto res = stream.read(buffer);
+        if (res && *res == 0 && !buffer.empty()) {
+            return utils::trans_error_code(utils::detail::closed_by_peer);
+        }
+        return res;
+    });
+}
+
+inline auto async_write(shm_stream &stream, std::span<char const> data) {
+    return detail::shm_io_awaiter(stream, false, [data](shm_stream &stream) -> utils::expected<std::size_t, std::error_code> {
+        auto res = stream.write(data);
+        if (!res && res.error() == utils::trans_error_code(EPIPE)) {
+            return utils::trans_error_code(utils::detail::closed_by_peer);
+        }
+        return res;
+    });
+}
+
+} /* namespace bc::network */
+
+#endif /* __BC_NETWORK_SHM_H__ */
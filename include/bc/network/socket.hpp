@@ -5,27 +5,45 @@
 #ifndef __BC_NETWORK_SOCKET_H__
 #define __BC_NETWORK_SOCKET_H__
 
+#include <linux/filter.h>
+#include <netinet/tcp.h>
+#include <netinet/udp.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <unistd.h>
+#include <algorithm>
+#include <array>
 #include <cassert>
 #include <cerrno>
+#include <chrono>
 #include <coroutine>
 #include <cstddef>
+#include <cstdint>
 #include <cstring>
 #include <span>
 #include <string_view>
 #include <system_error>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
 #include <bc/utils/expected.hpp>
 #include <bc/utils/error.hpp>
 #include <bc/utils/noncopyable.hpp>
 #include <bc/async/task.hpp>
 #include <bc/async/scheduler.hpp>
+#include <bc/async/trace.hpp>
 
 #include "address.hpp"
 
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+
 namespace bc::network {
 
 enum class protocol {
@@ -46,25 +64,22 @@ public:
     async_connect_awaiter(int fd, address const &addr) : fd_(fd), addr_(addr) {}
 
     auto await_ready() -> bool {
-        while (true) {
-            if (::connect(fd_, addr_.sockaddr(), addr_.socklen()) == -1) {
-                if (errno == EINTR) {
-                    log::info("connect returns negligible error, fd: {}, errno: {}, message: {}", fd_, errno, ::strerror(errno));
-                    continue;
-                }
-                else if (errno == EINPROGRESS) {
-                    return false;
-                }
-                log::error("failed to connect, fd: {}, errno: {}, message: {}", fd_, errno, ::strerror(errno));
-                throw;
+        while (::connect(fd_, addr_.sockaddr(), addr_.socklen()) == -1) {
+            if (errno == EINTR) {
+                continue;
             }
-            else {
-                return true;
+            if (errno == EINPROGRESS) {
+                return false;
             }
+            log::error("failed to connect, fd: {}, errno: {}, message: {}", fd_, errno, ::strerror(errno));
+            error_ = utils::trans_error_code(errno);
+            break;
         }
+        return true;
     }
 
     auto await_suspend(std::coroutine_handle<> handle) noexcept {
+        async::trace::instant("suspend_connect", fd_, handle.address());
         async::default_scheduler().post_coro(fd_,
             async::WRITE | async::ERROR | async::HANGUP,
             revent_,
@@ -73,36 +88,109 @@ public:
         return true;
     }
 
-    auto await_resume() noexcept -> bool {
-        log::debug("async write awaiter resume, fd: {}, revent: {}", fd_, revent_);
-        if (revent_ & async::ERROR) {
-            return false;
+    /*
+     * Empty on success; otherwise why the connection was not established.
+     */
+    auto await_resume() noexcept -> std::error_code {
+        log::debug("async connect awaiter resume, fd: {}, revent: {}", fd_, revent_);
+        if (revent_ == async::NONE) {
+            return error_;
         }
-        else if (revent_ & (async::HANGUP | async::RDHANGUP)) {
-            return false;
+        int error = 0;
+        socklen_t len = sizeof(error);
+        if (::getsockopt(fd_, SOL_SOCKET, SO_ERROR, &error, &len) == -1) {
+            error = errno;
         }
-        auto res = ::connect(fd_, addr_.sockaddr(), addr_.socklen());
-        if (res == -1) {
-            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
-                log::info("connect returns negligible error, fd: {}, errno: {}, message: {}", fd_, errno, ::strerror(errno));
-                return false;
-            }
-            log::error("failed to connect, fd: {}, errno: {}, message: {}", fd_, errno, ::strerror(errno));
-            return false;
+        if (error) {
+            log::info("failed to connect, fd: {}, errno: {}, message: {}", fd_, error, ::strerror(error));
+            return utils::trans_error_code(error);
         }
-        return true;
+        return {};
     }
 
 private:
     int fd_;
     address addr_;
     async::event revent_ {async::NONE};
+    std::error_code error_;
 };
 
 }
 
+/*
+ * A received datagram: the filled part of the caller's buffer and its
+ * sender. With UDP_GRO enabled several datagrams of segment_size bytes may
+ * arrive coalesced, the last one possibly shorter; 0 means not coalesced.
+ */
+struct datagram {
+    std::span<char> data;
+    address peer;
+    std::uint16_t segment_size {0};
+};
+
+/*
+ * A datagram to send. A non-zero segment_size asks the kernel (UDP_SEGMENT)
+ * to split data into datagrams of that size, so one buffer carries many.
+ */
+struct outgoing {
+    std::span<char const> data;
+    address peer;
+    std::uint16_t segment_size {0};
+};
+
+/*
+ * Bytes read from a Unix domain socket with the sender's credentials, when
+ * the kernel attached them; see socket::set_pass_credentials.
+ */
+struct credentialed_read {
+    std::size_t bytes;
+    std::optional<ucred> sender;
+};
+
+/*
+ * Bytes read from a Unix domain socket with the descriptors passed along,
+ * now open in this process and owned by the reader.
+ */
+struct descriptor_read {
+    std::size_t bytes;
+    std::vector<int> fds;
+};
+
+/*
+ * Keepalive probing: the first probe after idle without traffic, then one
+ * every interval; the connection is dropped after count unanswered probes.
+ */
+struct keepalive_timers {
+    std::chrono::seconds idle;
+    std::chrono::seconds interval;
+    int count;
+};
+
+/*
+ * Options to apply together; unset ones are left alone. TCP-level ones are
+ * ignored on UDP sockets.
+ */
+struct socket_options {
+    std::optional<bool> no_delay {};
+    std::optional<bool> cork {};
+    std::optional<bool> quick_ack {};
+    std::optional<int> send_buffer {};
+    std::optional<int> receive_buffer {};
+    std::optional<int> notsent_lowat {};
+    /* enables keepalive with these timers */
+    std::optional<keepalive_timers> keepalive {};
+    /* enables lingering on close for at most this long, 0 resets instead */
+    std::optional<std::chrono::seconds> linger {};
+    std::optional<std::chrono::milliseconds> user_timeout {};
+};
+
 template <protocol proto>
 class socket : private bc::utils::noncopyable {
+public:
+    constexpr static std::size_t s_max_batch = 64;
+    /* SCM_MAX_FD, the most descriptors one message carries */
+    constexpr static std::size_t s_max_descriptors = 253;
+
 public:
     static auto wrap(int fd, domain domain, role role) -> socket {
         socket socket;
@@ -112,6 +200,19 @@ public:
         return socket;
     }
 
+    /*
+     * Two connected Unix domain sockets, e.g. for a child process or another
+     * thread's scheduler.
+     */
+    static auto pair() -> std::pair<socket, socket> {
+        int fds[2];
+        if (::socketpair(AF_UNIX, std::to_underlying(proto) | SOCK_CLOEXEC | SOCK_NONBLOCK, 0, fds) == -1) {
+            log::error("failed to create socket pair, errno: {}, message: {}", errno, ::strerror(errno));
+            throw utils::trans_error_code(errno);
+        }
+        return {wrap(fds[0], domain::UNIX, role::PEER), wrap(fds[1], domain::UNIX, role::PEER)};
+    }
+
 public:
     socket() = default;
     socket(socket &&other) : fd_(other.fd_), domain_(other.domain_), role_(other.role_) {
@@ -142,13 +243,21 @@ public:
         }
     }
 
-    auto bind(address const &addr) -> void {
+    /*
+     * With reuse_port, every socket bound the same way joins one group and the
+     * kernel spreads incoming connections or datagrams across its members.
+     */
+    auto bind(address const &addr, bool reuse_port = false) -> void {
         use_domain_(addr.domain());
         int reuse = 1;
         if (::setsockopt(fd_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) == -1) {
             log::error("failed to set reuse option, fd: {}, errno: {}, message: {}", fd_, errno, ::strerror(errno));
             throw utils::trans_error_code(errno);
         }
+        if (reuse_port && ::setsockopt(fd_, SOL_SOCKET, SO_REUSEPORT, &reuse, sizeof(reuse)) == -1) {
+            log::error("failed to set reuse port option, fd: {}, errno: {}, message: {}", fd_, errno, ::strerror(errno));
+            throw utils::trans_error_code(errno);
+        }
         if (::bind(fd_, addr.sockaddr(), addr.socklen()) == -1) {
             log::error("failed to bind socket to {}, fd: {}, errno: {}, message: {}", addr, fd_, errno, ::strerror(errno));
             throw utils::trans_error_code(errno);
@@ -164,11 +273,27 @@ public:
         role_ = role::SERVER;
     }
 
-    auto listen(address const &addr, std::size_t backlog) -> void {
-        bind(addr);
+    auto listen(address const &addr, std::size_t backlog, bool reuse_port = false) -> void {
+        bind(addr, reuse_port);
         listen(backlog);
     }
 
+    /*
+     * Replaces the hash that picks a member of this socket's SO_REUSEPORT
+     * group: the program returns the index of the member, in bind order, and
+     * out-of-range results fall back to the hash. Any member may install it.
+     */
+    auto attach_reuseport_filter(std::span<sock_filter const> program) -> void {
+        sock_fprog prog {
+            .len = static_cast<unsigned short>(program.size()),
+            .filter = const_cast<sock_filter *>(program.data()),
+        };
+        if (::setsockopt(fd_, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog)) == -1) {
+            log::error("failed to attach reuseport filter, fd: {}, errno: {}, message: {}", fd_, errno, ::strerror(errno));
+            throw utils::trans_error_code(errno);
+        }
+    }
+
     auto async_connect(address const &addr) -> detail::async_connect_awaiter {
         if (fd_ == 0) {
             use_domain_(addr.domain());
@@ -181,32 +306,506 @@ public:
         return {fd_, addr};
     }
 
+    /*
+     * Non-blocking; reports resource_unavailable_try_again when nothing is
+     * buffered and 0 at end of stream.
+     */
     auto read(std::span<char> buffer) -> utils::expected<std::size_t, std::error_code> {
-        auto res = ::read(fd_, buffer.data(), buffer.size());
+        while (true) {
+            auto res = ::read(fd_, buffer.data(), buffer.size());
+            if (res == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                    log::error("failed to read, fd: {}, errno: {}, message: {}", fd_, errno, ::strerror(errno));
+                }
+                return utils::trans_error_code(errno == EWOULDBLOCK ? EAGAIN : errno);
+            }
+            return res;
+        }
+    }
+
+    /*
+     * Non-blocking; reports resource_unavailable_try_again when the send
+     * buffer is full. Never raises SIGPIPE.
+     */
+    auto write(std::string_view data) -> utils::expected<std::size_t, std::error_code> {
+        while (true) {
+            auto res = ::send(fd_, data.data(), data.size(), MSG_NOSIGNAL);
+            if (res == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                    log::error("failed to write, fd: {}, errno: {}, message: {}", fd_, errno, ::strerror(errno));
+                }
+                return utils::trans_error_code(errno == EWOULDBLOCK ? EAGAIN : errno);
+            }
+            return res;
+        }
+    }
+
+    auto readv(std::span<iovec const> iov) -> utils::expected<std::size_t, std::error_code> {
+        while (true) {
+            auto res = ::readv(fd_, iov.data(), iov.size());
+            if (res == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                    log::error("failed to readv, fd: {}, errno: {}, message: {}", fd_, errno, ::strerror(errno));
+                }
+                return utils::trans_error_code(errno == EWOULDBLOCK ? EAGAIN : errno);
+            }
+            return res;
+        }
+    }
+
+    /*
+     * Gathers every buffer into one sendmsg, without SIGPIPE.
+     */
+    auto writev(std::span<iovec const> iov) -> utils::expected<std::size_t, std::error_code> {
+        msghdr msg {};
+        msg.msg_iov = const_cast<iovec *>(iov.data());
+        msg.msg_iovlen = iov.size();
+        while (true) {
+            auto res = ::sendmsg(fd_, &msg, MSG_NOSIGNAL);
+            if (res == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                    log::error("failed to writev, fd: {}, errno: {}, message: {}", fd_, errno, ::strerror(errno));
+                }
+                return utils::trans_error_code(errno == EWOULDBLOCK ? EAGAIN : errno);
+            }
+            return res;
+        }
+    }
+
+    /*
+     * Creates the descriptor without binding, for sockets that only send or
+     * are connected later.
+     */
+    auto open(network::domain domain) -> void {
+        use_domain_(domain);
+    }
+
+    /*
+     * Lets the kernel coalesce consecutive datagrams from one flow into a
+     * single receive; see datagram::segment_size.
+     */
+    auto enable_gro() -> void {
+        static_assert(proto == protocol::UDP);
+        int one = 1;
+        if (::setsockopt(fd_, SOL_UDP, UDP_GRO, &one, sizeof(one)) == -1) {
+            log::error("failed to enable gro, fd: {}, errno: {}, message: {}", fd_, errno, ::strerror(errno));
+            throw utils::trans_error_code(errno);
+        }
+    }
+
+    /*
+     * Tuning setters report failures instead of throwing, so they can be
+     * applied to accepted sockets in bulk; getters read back what the kernel
+     * actually uses, e.g. buffer sizes come back doubled.
+     */
+    auto set_no_delay(bool on) -> std::error_code {
+        static_assert(proto == protocol::TCP);
+        return set_option_(IPPROTO_TCP, TCP_NODELAY, int {on});
+    }
+
+    auto no_delay() const -> utils::expected<bool, std::error_code> {
+        return get_flag_(IPPROTO_TCP, TCP_NODELAY);
+    }
+
+    /*
+     * Holds partial frames back until uncorked, to batch headers and body.
+     */
+    auto set_cork(bool on) -> std::error_code {
+        static_assert(proto == protocol::TCP);
+        return set_option_(IPPROTO_TCP, TCP_CORK, int {on});
+    }
+
+    auto cork() const -> utils::expected<bool, std::error_code> {
+        return get_flag_(IPPROTO_TCP, TCP_CORK);
+    }
+
+    /*
+     * Not sticky: the kernel may fall back to delayed acks, so it is usually
+     * set again after each read.
+     */
+    auto set_quick_ack(bool on) -> std::error_code {
+        static_assert(proto == protocol::TCP);
+        return set_option_(IPPROTO_TCP, TCP_QUICKACK, int {on});
+    }
+
+    auto quick_ack() const -> utils::expected<bool, std::error_code> {
+        return get_flag_(IPPROTO_TCP, TCP_QUICKACK);
+    }
+
+    auto set_send_buffer(int bytes) -> std::error_code {
+        return set_option_(SOL_SOCKET, SO_SNDBUF, bytes);
+    }
+
+    auto send_buffer() const -> utils::expected<int, std::error_code> {
+        return get_option_<int>(SOL_SOCKET, SO_SNDBUF);
+    }
+
+    auto set_receive_buffer(int bytes) -> std::error_code {
+        return set_option_(SOL_SOCKET, SO_RCVBUF, bytes);
+    }
+
+    auto receive_buffer() const -> utils::expected<int, std::error_code> {
+        return get_option_<int>(SOL_SOCKET, SO_RCVBUF);
+    }
+
+    /*
+     * Caps unsent bytes queued in the kernel; WRITE readiness waits for the
+     * queue to drain below it, keeping latency-sensitive data in user space.
+     */
+    auto set_notsent_lowat(int bytes) -> std::error_code {
+        static_assert(proto == protocol::TCP);
+        return set_option_(IPPROTO_TCP, TCP_NOTSENT_LOWAT, bytes);
+    }
+
+    auto notsent_lowat() const -> utils::expected<int, std::error_code> {
+        return get_option_<int>(IPPROTO_TCP, TCP_NOTSENT_LOWAT);
+    }
+
+    /*
+     * Disables keepalive when timers is empty.
+     */
+    auto set_keepalive(std::optional<keepalive_timers> timers) -> std::error_code {
+        if (auto ec = set_option_(SOL_SOCKET, SO_KEEPALIVE, int {timers.has_value()}); ec || !timers) {
+            return ec;
+        }
+        if constexpr (proto == protocol::TCP) {
+            if (auto ec = set_option_(IPPROTO_TCP, TCP_KEEPIDLE, static_cast<int>(timers->idle.count()))) {
+                return ec;
+            }
+            if (auto ec = set_option_(IPPROTO_TCP, TCP_KEEPINTVL, static_cast<int>(timers->interval.count()))) {
+                return ec;
+            }
+            return set_option_(IPPROTO_TCP, TCP_KEEPCNT, timers->count);
+        }
+        return {};
+    }
+
+    auto keepalive() const -> utils::expected<std::optional<keepalive_timers>, std::error_code> {
+        static_assert(proto == protocol::TCP);
+        auto on = get_flag_(SOL_SOCKET, SO_KEEPALIVE);
+        if (!on) {
+            return on.error();
+        }
+        if (!*on) {
+            return std::optional<keepalive_timers> {};
+        }
+        auto idle = get_option_<int>(IPPROTO_TCP, TCP_KEEPIDLE);
+        auto interval = get_option_<int>(IPPROTO_TCP, TCP_KEEPINTVL);
+        auto count = get_option_<int>(IPPROTO_TCP, TCP_KEEPCNT);
+        if (!idle || !interval || !count) {
+            return !idle ? idle.error() : !interval ? interval.error() : count.error();
+        }
+        return std::optional<keepalive_timers> {keepalive_timers {std::chrono::seconds(*idle), std::chrono::seconds(*interval), *count}};
+    }
+
+    /*
+     * With a timeout, close() blocks until unsent data is acknowledged or the
+     * timeout passes; a zero timeout resets the connection. Empty restores
+     * the default background close.
+     */
+    auto set_linger(std::optional<std::chrono::seconds> timeout) -> std::error_code {
+        ::linger value {.l_onoff = timeout.has_value(), .l_linger = timeout ? static_cast<int>(timeout->count()) : 0};
+        return set_option_(SOL_SOCKET, SO_LINGER, value);
+    }
+
+    auto linger() const -> utils::expected<std::optional<std::chrono::seconds>, std::error_code> {
+        auto value = get_option_<::linger>(SOL_SOCKET, SO_LINGER);
+        if (!value) {
+            return value.error();
+        }
+        if (!value->l_onoff) {
+            return std::optional<std::chrono::seconds> {};
+        }
+        return std::optional<std::chrono::seconds> {std::chrono::seconds(value->l_linger)};
+    }
+
+    /*
+     * Gives up on the connection when sent data stays unacknowledged this
+     * long; zero restores the system default.
+     */
+    auto set_user_timeout(std::chrono::milliseconds timeout) -> std::error_code {
+        static_assert(proto == protocol::TCP);
+        return set_option_(IPPROTO_TCP, TCP_USER_TIMEOUT, static_cast<unsigned>(timeout.count()));
+    }
+
+    auto user_timeout() const -> utils::expected<std::chrono::milliseconds, std::error_code> {
+        auto value = get_option_<unsigned>(IPPROTO_TCP, TCP_USER_TIMEOUT);
+        if (!value) {
+            return value.error();
+        }
+        return std::chrono::milliseconds(*value);
+    }
+
+    /*
+     * Applies every set option, stopping at the first failure.
+     */
+    auto apply(socket_options const &options) -> std::error_code {
+        std::error_code ec;
+        auto step = [&](auto const &option, auto &&set) {
+            if (!ec && option) {
+                ec = set(*option);
+            }
+        };
+        if constexpr (proto == protocol::TCP) {
+            if (domain_ == network::domain::UNIX) {
+                options_without_tcp_(options, step);
+                return ec;
+            }
+            step(options.no_delay, [&](bool on) { return set_no_delay(on); });
+            step(options.cork, [&](bool on) { return set_cork(on); });
+            step(options.quick_ack, [&](bool on) { return set_quick_ack(on); });
+            step(options.notsent_lowat, [&](int bytes) { return set_notsent_lowat(bytes); });
+            step(options.user_timeout, [&](std::chrono::milliseconds timeout) { return set_user_timeout(timeout); });
+        }
+        options_without_tcp_(options, step);
+        return ec;
+    }
+
+    /*
+     * Who is on the other end of a Unix domain socket, as of connect or
+     * socketpair time.
+     */
+    auto peer_credentials() const -> utils::expected<ucred, std::error_code> {
+        return get_option_<ucred>(SOL_SOCKET, SO_PEERCRED);
+    }
+
+    /*
+     * Has the kernel attach SCM_CREDENTIALS to received data, which the
+     * sender cannot forge beyond its own privileges.
+     */
+    auto set_pass_credentials(bool on) -> std::error_code {
+        return set_option_(SOL_SOCKET, SO_PASSCRED, int {on});
+    }
+
+    auto read_with_credentials(std::span<char> buffer) -> utils::expected<credentialed_read, std::error_code> {
+        alignas(cmsghdr) char control[CMSG_SPACE(sizeof(ucred))];
+        iovec iov {buffer.data(), buffer.size()};
+        msghdr msg {};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        ssize_t res;
+        while ((res = ::recvmsg(fd_, &msg, MSG_CMSG_CLOEXEC)) == -1 && errno == EINTR) {}
         if (res == -1) {
-            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
-                log::info("read returns negligible error, fd: {}, errno: {}, message: {}", fd_, errno, ::strerror(errno));
-                return 0;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                log::error("failed to read, fd: {}, errno: {}, message: {}", fd_, errno, ::strerror(errno));
+            }
+            return utils::trans_error_code(errno == EWOULDBLOCK ? EAGAIN : errno);
+        }
+        credentialed_read read {static_cast<std::size_t>(res), std::nullopt};
+        for (auto *cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+            if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_CREDENTIALS) {
+                ucred cred;
+                std::memcpy(&cred, CMSG_DATA(cm), sizeof(cred));
+                read.sender = cred;
+            }
+        }
+        return read;
+    }
+
+    /*
+     * Sends data over a Unix domain socket with descriptors attached as
+     * SCM_RIGHTS; the receiver gets its own descriptors for the same open
+     * sockets and files. data must not be empty, or they do not travel.
+     */
+    auto write_with_descriptors(std::string_view data, std::span<int const> fds) -> utils::expected<std::size_t, std::error_code> {
+        assert(!data.empty() && fds.size() <= s_max_descriptors);
+        alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * s_max_descriptors)];
+        iovec iov {const_cast<char *>(data.data()), data.size()};
+        msghdr msg {};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        if (!fds.empty()) {
+            msg.msg_control = control;
+            msg.msg_controllen = CMSG_SPACE(sizeof(int) * fds.size());
+            auto *cm = CMSG_FIRSTHDR(&msg);
+            cm->cmsg_level = SOL_SOCKET;
+            cm->cmsg_type = SCM_RIGHTS;
+            cm->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+            std::memcpy(CMSG_DATA(cm), fds.data(), sizeof(int) * fds.size());
+        }
+        ssize_t res;
+        while ((res = ::sendmsg(fd_, &msg, MSG_NOSIGNAL)) == -1 && errno == EINTR) {}
+        if (res == -1) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                log::error("failed to send descriptors, fd: {}, errno: {}, message: {}", fd_, errno, ::strerror(errno));
+            }
+            return utils::trans_error_code(errno == EWOULDBLOCK ? EAGAIN : errno);
+        }
+        return static_cast<std::size_t>(res);
+    }
+
+    /*
+     * Reads data and the descriptors that came with it, close-on-exec. When
+     * the kernel had to drop some for lack of room, the ones that arrived
+     * are closed and the read fails with message_size.
+     */
+    auto read_with_descriptors(std::span<char> buffer) -> utils::expected<descriptor_read, std::error_code> {
+        alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * s_max_descriptors)];
+        iovec iov {buffer.data(), buffer.size()};
+        msghdr msg {};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        ssize_t res;
+        while ((res = ::recvmsg(fd_, &msg, MSG_CMSG_CLOEXEC)) == -1 && errno == EINTR) {}
+        if (res == -1) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                log::error("failed to read descriptors, fd: {}, errno: {}, message: {}", fd_, errno, ::strerror(errno));
+            }
+            return utils::trans_error_code(errno == EWOULDBLOCK ? EAGAIN : errno);
+        }
+        descriptor_read read {static_cast<std::size_t>(res), {}};
+        for (auto *cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+            if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_RIGHTS) {
+                auto count = (cm->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+                auto offset = read.fds.size();
+                read.fds.resize(offset + count);
+                std::memcpy(read.fds.data() + offset, CMSG_DATA(cm), sizeof(int) * count);
+            }
+        }
+        if (msg.msg_flags & MSG_CTRUNC) {
+            log::error("descriptors dropped by the kernel, fd: {}, received: {}", fd_, read.fds.size());
+            for (int fd : read.fds) {
+                ::close(fd);
+            }
+            return utils::trans_error_code(utils::detail::message_size);
+        }
+        return read;
+    }
+
+    auto recv_from(std::span<char> buffer) -> utils::expected<datagram, std::error_code> {
+        datagram dgram;
+        auto res = recv_many({&buffer, 1}, {&dgram, 1});
+        if (!res) {
+            return res.error();
+        }
+        return dgram;
+    }
+
+    auto send_to(std::span<char const> data, address const &peer) -> utils::expected<std::size_t, std::error_code> {
+        outgoing out {data, peer};
+        auto res = send_many({&out, 1});
+        if (!res) {
+            return res.error();
+        }
+        return data.size();
+    }
+
+    /*
+     * One recvmmsg filling up to s_max_batch buffers; reports how many
+     * datagrams arrived, or would-block when none did.
+     */
+    auto recv_many(std::span<std::span<char> const> buffers, std::span<datagram> out) -> utils::expected<std::size_t, std::error_code> {
+        auto n = std::min({buffers.size(), out.size(), s_max_batch});
+        std::array<mmsghdr, s_max_batch> msgs;
+        std::array<iovec, s_max_batch> iovs;
+        std::array<sockaddr_storage, s_max_batch> peers;
+        std::array<std::array<char, CMSG_SPACE(sizeof(int))>, s_max_batch> controls;
+        for (std::size_t i = 0; i < n; ++i) {
+            iovs[i] = {buffers[i].data(), buffers[i].size()};
+            msgs[i] = {};
+            msgs[i].msg_hdr.msg_name = &peers[i];
+            msgs[i].msg_hdr.msg_namelen = sizeof(peers[i]);
+            msgs[i].msg_hdr.msg_iov = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+            msgs[i].msg_hdr.msg_control = controls[i].data();
+            msgs[i].msg_hdr.msg_controllen = controls[i].size();
+        }
+        int res;
+        while ((res = ::recvmmsg(fd_, msgs.data(), n, 0, nullptr)) == -1 && errno == EINTR) {}
+        if (res == -1) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                log::error("failed to receive datagrams, fd: {}, errno: {}, message: {}", fd_, errno, ::strerror(errno));
+            }
+            return utils::trans_error_code(errno == EWOULDBLOCK ? EAGAIN : errno);
+        }
+        for (int i = 0; i < res; ++i) {
+            auto &hdr = msgs[i].msg_hdr;
+            out[i].data = buffers[i].first(msgs[i].msg_len);
+            out[i].peer = address::from(peers[i], hdr.msg_namelen).value_or(address {});
+            out[i].segment_size = 0;
+            for (auto *cm = CMSG_FIRSTHDR(&hdr); cm; cm = CMSG_NXTHDR(&hdr, cm)) {
+                if (cm->cmsg_level == SOL_UDP && cm->cmsg_type == UDP_GRO) {
+                    int size;
+                    std::memcpy(&size, CMSG_DATA(cm), sizeof(size));
+                    out[i].segment_size = size;
+                }
             }
-            log::error("failed to read, fd: {}, errno: {}, message: {}", fd_, errno, ::strerror(errno));
-            return utils::trans_error_code(errno);
         }
         return res;
     }
 
-    auto write(std::string_view data) -> utils::expected<std::size_t, std::error_code> {
-        auto res = ::write(fd_, data.data(), data.size());
+    /*
+     * One sendmmsg of up to s_max_batch datagrams; reports how many were
+     * queued, which may be fewer than given.
+     */
+    auto send_many(std::span<outgoing const> datagrams) -> utils::expected<std::size_t, std::error_code> {
+        auto n = std::min(datagrams.size(), s_max_batch);
+        std::array<mmsghdr, s_max_batch> msgs;
+        std::array<iovec, s_max_batch> iovs;
+        std::array<std::array<char, CMSG_SPACE(sizeof(std::uint16_t))>, s_max_batch> controls;
+        for (std::size_t i = 0; i < n; ++i) {
+            auto const &dgram = datagrams[i];
+            iovs[i] = {const_cast<char *>(dgram.data.data()), dgram.data.size()};
+            msgs[i] = {};
+            msgs[i].msg_hdr.msg_name = const_cast<struct sockaddr *>(dgram.peer.sockaddr());
+            msgs[i].msg_hdr.msg_namelen = dgram.peer.socklen();
+            msgs[i].msg_hdr.msg_iov = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+            if (dgram.segment_size) {
+                msgs[i].msg_hdr.msg_control = controls[i].data();
+                msgs[i].msg_hdr.msg_controllen = controls[i].size();
+                auto *cm = CMSG_FIRSTHDR(&msgs[i].msg_hdr);
+                cm->cmsg_level = SOL_UDP;
+                cm->cmsg_type = UDP_SEGMENT;
+                cm->cmsg_len = CMSG_LEN(sizeof(std::uint16_t));
+                std::memcpy(CMSG_DATA(cm), &dgram.segment_size, sizeof(std::uint16_t));
+            }
+        }
+        int res;
+        while ((res = ::sendmmsg(fd_, msgs.data(), n, MSG_NOSIGNAL)) == -1 && errno == EINTR) {}
         if (res == -1) {
-            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
-                log::info("write returns negligible error, fd: {}, errno: {}, message: {}", fd_, errno, ::strerror(errno));
-                return 0;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                log::error("failed to send datagrams, fd: {}, errno: {}, message: {}", fd_, errno, ::strerror(errno));
             }
-            log::error("failed to write, fd: {}, errno: {}, message: {}", fd_, errno, ::strerror(errno));
-            return utils::trans_error_code(errno);
+            return utils::trans_error_code(errno == EWOULDBLOCK ? EAGAIN : errno);
         }
         return res;
     }
 
+    auto peer_address() const -> utils::expected<address, std::error_code> {
+        sockaddr_storage storage;
+        socklen_t len = sizeof(storage);
+        if (::getpeername(fd_, reinterpret_cast<struct sockaddr *>(&storage), &len) == -1) {
+            return utils::trans_error_code(errno);
+        }
+        return address::from(storage, len);
+    }
+
+    auto local_address() const -> utils::expected<address, std::error_code> {
+        sockaddr_storage storage;
+        socklen_t len = sizeof(storage);
+        if (::getsockname(fd_, reinterpret_cast<struct sockaddr *>(&storage), &len) == -1) {
+            return utils::trans_error_code(errno);
+        }
+        return address::from(storage, len);
+    }
+
     auto descriptor() const -> int { return fd_; }
     auto domain() const -> network::domain { return domain_; }
 
@@ -216,13 +815,55 @@ private:
         role_ = role::UNDETERMINED;
     }
 
+    /*
+     * The socket-level part of apply(), all that a Unix domain socket takes.
+     */
+    template <typename Step>
+    auto options_without_tcp_(socket_options const &options, Step &step) -> void {
+        step(options.send_buffer, [&](int bytes) { return set_send_buffer(bytes); });
+        step(options.receive_buffer, [&](int bytes) { return set_receive_buffer(bytes); });
+        if (domain_ != network::domain::UNIX) {
+            step(options.keepalive, [&](keepalive_timers const &timers) { return set_keepalive(timers); });
+        }
+        step(options.linger, [&](std::chrono::seconds timeout) { return set_linger(timeout); });
+    }
+
+    template <typename T>
+    auto set_option_(int level, int name, T const &value) -> std::error_code {
+        // not logged: failing on a peer that is already gone is routine, callers pick the level
+        if (::setsockopt(fd_, level, name, &value, sizeof(value)) == -1) {
+            return utils::trans_error_code(errno);
+        }
+        return {};
+    }
+
+    template <typename T>
+    auto get_option_(int level, int name) const -> utils::expected<T, std::error_code> {
+        T value {};
+        socklen_t len = sizeof(value);
+        if (::getsockopt(fd_, level, name, &value, &len) == -1) {
+            return utils::trans_error_code(errno);
+        }
+        return value;
+    }
+
+    auto get_flag_(int level, int name) const -> utils::expected<bool, std::error_code> {
+        auto value = get_option_<int>(level, name);
+        if (!value) {
+            return value.error();
+        }
+        return *value != 0;
+    }
+
     auto use_domain_(network::domain domain) -> void {
         assert(fd_ == 0);
-        fd_ = ::socket(std::to_underlying(domain), std::to_underlying(proto) | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
-        if (fd_ == -1) {
+        // on failure the socket stays empty, so its destructor has nothing to close
+        int fd = ::socket(std::to_underlying(domain), std::to_underlying(proto) | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+        if (fd == -1) {
             log::error("failed to create socket, errno: {}, message: {}", errno, ::strerror(errno));
             throw utils::trans_error_code(errno);
         }
+        fd_ = fd;
         domain_ = domain;
     }
 
@@ -232,32 +873,32 @@ private:
     role role_ {role::UNDETERMINED};
 };
 
+template <protocol proto>
+struct accepted {
+    socket<proto> sock;
+    address peer;
+};
+
 namespace detail {
 
 template <protocol proto>
 class async_accept_awaiter {
 public:
-    async_accept_awaiter(socket<proto> &sock) : sock_(sock) {}
+    async_accept_awaiter(socket<proto> &sock, async::event e = async::READ) : sock_(sock), event_(e) {}
 
     auto await_ready() -> bool {
-        return false;
+        return accept_();
     }
 
     auto await_suspend(std::coroutine_handle<> handle) noexcept {
-        async::default_scheduler().post_coro(sock_.descriptor(), async::READ, revent_, [&, next=handle] {
+        async::trace::instant("suspend_accept", sock_.descriptor(), handle.address());
+        async::default_scheduler().post_coro(sock_.descriptor(), event_, revent_, [&, next=handle] {
             log::debug("async accept proxy was called, fd: {}, revent: {}", sock_.descriptor(), revent_);
-            int fd = ::accept4(sock_.descriptor(), nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK);
-            if (fd == -1) {
-                if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
-                    // TODO: ECONNABORTED, ENOBUFS, EPERM, EPROTO, ENOSR, ESOCKTNOSUPPORT, EPROTONOSUPPORT, ETIMEOUT, ERESETARTSYS
-                    log::info("accept returns negligible error, fd: {}, error: {}, message: {}", sock_.descriptor(), errno, ::strerror(errno));
-                    return false;
-                }
-                log::error("failed to accept, fd: {}, errno: {}, message: {}", sock_.descriptor(), errno, ::strerror(errno));
-                res_ = utils::trans_error_code(errno);
+            if (revent_ & async::CANCELED) {
+                res_ = utils::trans_error_code(utils::detail::operation_canceled);
             }
-            else {
-                res_ = socket<proto>::wrap(fd, sock_.domain(), role::PEER);
+            else if (!accept_()) {
+                return false;
             }
             next.resume();
             return true;
@@ -270,49 +911,152 @@ public:
         return std::move(res_);
     }
 
+private:
+    /*
+     * Returns false when there is nothing to accept yet.
+     */
+    auto accept_() -> bool {
+        int fd = ::accept4(sock_.descriptor(), nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK);
+        if (fd == -1) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR || errno == ECONNABORTED) {
+                log::debug("accept returns negligible error, fd: {}, error: {}, message: {}", sock_.descriptor(), errno, ::strerror(errno));
+                return false;
+            }
+            log::error("failed to accept, fd: {}, errno: {}, message: {}", sock_.descriptor(), errno, ::strerror(errno));
+            res_ = utils::trans_error_code(errno);
+        }
+        else {
+            res_ = socket<proto>::wrap(fd, sock_.domain(), role::PEER);
+        }
+        return true;
+    }
+
 private:
     socket<proto> &sock_;
+    async::event event_;
     async::event revent_ {async::NONE};
     utils::expected<socket<proto>, std::error_code> res_;
 };
 
+/*
+ * Drains the accept queue up to a budget per wakeup, so a connection storm
+ * costs one scheduler round per batch instead of per connection. Resumes
+ * with at least one socket or an error. An error met after some sockets were
+ * accepted is dropped in favour of them; a lasting one, such as EMFILE,
+ * fails the next call again.
+ */
+template <protocol proto>
+class async_accept_many_awaiter {
+public:
+    async_accept_many_awaiter(socket<proto> &sock, std::size_t budget, async::event e) : sock_(sock), budget_(budget), event_(e) {}
+
+    auto await_ready() -> bool {
+        return accept_();
+    }
+
+    auto await_suspend(std::coroutine_handle<> handle) noexcept {
+        async::trace::instant("suspend_accept_many", sock_.descriptor(), handle.address());
+        async::default_scheduler().post_coro(sock_.descriptor(), event_, revent_, [&, next=handle] {
+            if (revent_ & async::CANCELED) {
+                error_ = utils::trans_error_code(utils::detail::operation_canceled);
+            }
+            else if (!accept_()) {
+                return false;
+            }
+            next.resume();
+            return true;
+        });
+        return true;
+    }
+
+    auto await_resume() noexcept -> utils::expected<std::vector<accepted<proto>>, std::error_code> {
+        if (error_ && batch_.empty()) {
+            return *error_;
+        }
+        return std::move(batch_);
+    }
+
+private:
+    /*
+     * Returns false when nothing was accepted and nothing failed.
+     */
+    auto accept_() -> bool {
+        while (batch_.size() < budget_) {
+            sockaddr_storage storage;
+            socklen_t len = sizeof(storage);
+            int fd = ::accept4(sock_.descriptor(), reinterpret_cast<struct sockaddr *>(&storage), &len, SOCK_CLOEXEC | SOCK_NONBLOCK);
+            if (fd == -1) {
+                if (errno == EINTR || errno == ECONNABORTED) {
+                    continue;
+                }
+                if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                    // reported by the caller, which knows whether it is worth an error
+                    log::debug("failed to accept, fd: {}, errno: {}, message: {}", sock_.descriptor(), errno, ::strerror(errno));
+                    error_ = utils::trans_error_code(errno);
+                }
+                break;
+            }
+            auto peer = address::from(storage, len);
+            batch_.push_back({socket<proto>::wrap(fd, sock_.domain(), role::PEER), peer ? *peer : address {}});
+        }
+        return !batch_.empty() || error_;
+    }
+
+private:
+    socket<proto> &sock_;
+    std::size_t budget_;
+    async::event event_;
+    async::event revent_ {async::NONE};
+    std::vector<accepted<proto>> batch_;
+    std::optional<std::error_code> error_;
+};
+
+/*
+ * Reads and writes are attempted before suspending: a request already in the
+ * receive buffer, or a reply that fits the send buffer, completes without an
+ * epoll registration. Only would-block parks the coroutine, and the retry runs
+ * from a proxy so a spurious wakeup does not resume it.
+ */
 template <protocol proto>
 class async_read_awaiter {
 public:
     async_read_awaiter(socket<proto> &sock, std::span<char> buffer) : sock_(sock), buffer_(buffer) {}
 
     auto await_ready() -> bool {
-        return false;
+        res_ = read_();
+        return res_ || !utils::would_block(res_.error());
     }
 
     auto await_suspend(std::coroutine_handle<> handle) noexcept -> bool {
+        async::trace::instant("suspend_read", sock_.descriptor(), handle.address());
         async::default_scheduler().post_coro(
             sock_.descriptor(),
             async::READ | async::ERROR | async::HANGUP | async::RDHANGUP,
             revent_,
-            handle
+            [this, next=handle] {
+                auto res = read_();
+                if (!res && utils::would_block(res.error())) {
+                    return false;
+                }
+                res_ = std::move(res);
+                next.resume();
+                return true;
+            }
         );
         return true;
     }
 
     auto await_resume() noexcept -> utils::expected<size_t, std::error_code> {
-        assert(revent_);
         log::debug("async read awaiter resume, fd: {}, revent: {}", sock_.descriptor(), revent_);
-        if (revent_ & async::ERROR) {
-            return utils::trans_error_code(utils::detail::epoll_error);
-        }
-        else if (revent_ & (async::HANGUP | async::RDHANGUP)) {
+        return std::move(res_);
+    }
+
+private:
+    auto read_() -> utils::expected<size_t, std::error_code> {
+        auto res = sock_.read(buffer_);
+        if (res && *res == 0 && !buffer_.empty()) {
             return utils::trans_error_code(utils::detail::closed_by_peer);
         }
-        auto res = ::read(sock_.descriptor(), buffer_.data(), buffer_.size());
-        if (res == -1) {
-            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
-                log::info("read returns negligible error, fd: {}, errno: {}, message: {}", sock_.descriptor(), errno, ::strerror(errno));
-                return 0;
-            }
-            log::error("failed to read, fd: {}, errno: {}, message: {}", sock_.descriptor(), errno, ::strerror(errno));
-            return utils::trans_error_code(errno);
-        }
         return res;
     }
 
@@ -320,6 +1064,7 @@ private:
     socket<proto> &sock_;
     std::span<char> buffer_;
     async::event revent_ {async::NONE};
+    utils::expected<size_t, std::error_code> res_;
 };
 
 template <protocol proto>
@@ -328,35 +1073,39 @@ public:
     async_write_awaiter(socket<proto> &sock, std::span<char> buffer) : sock_(sock), buffer_(buffer) {}
 
     auto await_ready() -> bool {
-        return false;
+        res_ = write_();
+        return res_ || !utils::would_block(res_.error());
     }
 
     auto await_suspend(std::coroutine_handle<> handle) noexcept {
+        async::trace::instant("suspend_write", sock_.descriptor(), handle.address());
         async::default_scheduler().post_coro(sock_.descriptor(),
             async::WRITE | async::ERROR | async::HANGUP,
             revent_,
-            handle
+            [this, next=handle] {
+                auto res = write_();
+                if (!res && utils::would_block(res.error())) {
+                    return false;
+                }
+                res_ = std::move(res);
+                next.resume();
+                return true;
+            }
         );
         return true;
     }
 
     auto await_resume() noexcept -> utils::expected<size_t, std::error_code> {
         log::debug("async write awaiter resume, fd: {}, revent: {}", sock_.descriptor(), revent_);
-        if (revent_ & async::ERROR) {
-            return utils::trans_error_code(utils::detail::epoll_error);
-        }
-        else if (revent_ & (async::HANGUP | async::RDHANGUP)) {
+        return std::move(res_);
+    }
+
+private:
+    auto write_() -> utils::expected<size_t, std::error_code> {
+        auto res = sock_.write({buffer_.data(), buffer_.size()});
+        if (!res && res.error() == utils::trans_error_code(EPIPE)) {
             return utils::trans_error_code(utils::detail::closed_by_peer);
         }
-        auto res = ::write(sock_.descriptor(), buffer_.data(), buffer_.size());
-        if (res == -1) {
-            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
-                log::info("write returns negligible error, fd: {}, errno: {}, message: {}", sock_.descriptor(), errno, ::strerror(errno));
-                return 0;
-            }
-            log::error("failed to write, fd: {}, errno: {}, message: {}", sock_.descriptor(), errno, ::strerror(errno));
-            return utils::trans_error_code(errno);
-        }
         return res;
     }
 
@@ -364,13 +1113,178 @@ private:
     socket<proto> &sock_;
     std::span<char> buffer_;
     async::event revent_ {async::NONE};
+    utils::expected<size_t, std::error_code> res_;
 };
 
+/*
+ * Scatter/gather transfer over a sequence of buffers, at most s_max_iov per
+ * syscall. With all set it keeps going across partial transfers, suspending
+ * on would-block, until every buffer is filled or sent; otherwise it
+ * completes after the first transfer, like async_read/async_write.
+ */
+template <protocol proto, typename Buffer>
+class async_vector_awaiter {
+    constexpr static bool s_reading = !std::is_const_v<typename Buffer::element_type>;
+    constexpr static std::size_t s_max_iov = 64;
+
+public:
+    async_vector_awaiter(socket<proto> &sock, std::span<Buffer const> buffers, bool all)
+        : sock_(sock), buffers_(buffers), all_(all) {}
+    async_vector_awaiter(socket<proto> &sock, Buffer buffer, bool all)
+        : sock_(sock), one_(buffer), single_(true), all_(all) {}
+    async_vector_awaiter(async_vector_awaiter const &) = delete;
+
+    auto await_ready() -> bool {
+        return step_();
+    }
+
+    auto await_suspend(std::coroutine_handle<> handle) noexcept {
+        async::trace::instant(s_reading ? "suspend_readv" : "suspend_writev", sock_.descriptor(), handle.address(), "done", done_);
+        auto e = s_reading ? async::READ | async::RDHANGUP : async::WRITE;
+        async::default_scheduler().post_coro(sock_.descriptor(), e | async::ERROR | async::HANGUP, revent_, [this, next=handle] {
+            if (!step_()) {
+                return false;
+            }
+            next.resume();
+            return true;
+        });
+        return true;
+    }
+
+    auto await_resume() noexcept -> utils::expected<size_t, std::error_code> {
+        if (error_) {
+            return *error_;
+        }
+        return done_;
+    }
+
+private:
+    auto buffers_view_() const -> std::span<Buffer const> {
+        return single_ ? std::span<Buffer const>(&one_, 1) : buffers_;
+    }
+
+    /*
+     * Returns false when would-block leaves work outstanding.
+     */
+    auto step_() -> bool {
+        auto buffers = buffers_view_();
+        while (index_ < buffers.size()) {
+            std::array<iovec, s_max_iov> iov;
+            std::size_t count = 0;
+            for (auto i = index_, offset = offset_; i < buffers.size() && count < s_max_iov; ++i, offset = 0) {
+                if (buffers[i].size() > offset) {
+                    iov[count++] = {const_cast<char *>(buffers[i].data()) + offset, buffers[i].size() - offset};
+                }
+            }
+            if (count == 0) {
+                break;
+            }
+            auto res = s_reading ? sock_.readv({iov.data(), count}) : sock_.writev({iov.data(), count});
+            if (!res) {
+                if (utils::would_block(res.error())) {
+                    return false;
+                }
+                error_ = res.error() == utils::trans_error_code(EPIPE) ? utils::trans_error_code(utils::detail::closed_by_peer) : res.error();
+                return true;
+            }
+            if (s_reading && *res == 0) {
+                error_ = utils::trans_error_code(utils::detail::closed_by_peer);
+                return true;
+            }
+            done_ += *res;
+            advance_(buffers, *res);
+            if (!all_) {
+                return true;
+            }
+        }
+        return true;
+    }
+
+    auto advance_(std::span<Buffer const> buffers, std::size_t n) -> void {
+        while (n && index_ < buffers.size()) {
+            auto left = buffers[index_].size() - offset_;
+            if (n < left) {
+                offset_ += n;
+                return;
+            }
+            n -= left;
+            ++index_;
+            offset_ = 0;
+        }
+    }
+
+private:
+    socket<proto> &sock_;
+    std::span<Buffer const> buffers_;
+    Buffer one_;
+    bool single_ {false};
+    bool all_;
+    std::size_t index_ {0};
+    std::size_t offset_ {0};
+    std::size_t done_ {0};
+    std::optional<std::error_code> error_;
+    async::event revent_ {async::NONE};
+};
+
+/*
+ * Optimistic awaiter for the datagram calls: tries op, suspends on
+ * would-block and retries from a proxy on readiness.
+ */
+template <protocol proto, typename Result, typename Op>
+class async_datagram_awaiter {
+public:
+    async_datagram_awaiter(socket<proto> &sock, async::event e, Op op) : sock_(sock), e_(e), op_(std::move(op)) {}
+
+    auto await_ready() -> bool {
+        res_ = op_(sock_);
+        return res_ || !utils::would_block(res_.error());
+    }
+
+    auto await_suspend(std::coroutine_handle<> handle) noexcept {
+        async::trace::instant(e_ & async::READ ? "suspend_recv" : "suspend_send", sock_.descriptor(), handle.address());
+        async::default_scheduler().post_coro(sock_.descriptor(), e_ | async::ERROR, revent_, [this, next=handle] {
+            auto res = op_(sock_);
+            if (!res && utils::would_block(res.error())) {
+                return false;
+            }
+            res_ = std::move(res);
+            next.resume();
+            return true;
+        });
+        return true;
+    }
+
+    auto await_resume() noexcept -> utils::expected<Result, std::error_code> {
+        return std::move(res_);
+    }
+
+private:
+    socket<proto> &sock_;
+    async::event e_;
+    Op op_;
+    async::event revent_ {async::NONE};
+    utils::expected<Result, std::error_code> res_;
+};
+
+template <typename Result, protocol proto, typename Op>
+auto make_datagram_awaiter(socket<proto> &sock, async::event e, Op op) -> async_datagram_awaiter<proto, Result, Op> {
+    return {sock, e, std::move(op)};
+}
+
 } /* namespace bc::network::detail */
 
+/*
+ * A listener shared by several schedulers is awaited with READ | EXCLUSIVE,
+ * so a connection wakes one of them instead of all.
+ */
+template <protocol proto>
+auto async_accept(socket<proto> &sock, async::event e = async::READ) -> detail::async_accept_awaiter<proto> {
+    return {sock, e};
+}
+
 template <protocol proto>
-auto async_accept(socket<proto> &sock) -> detail::async_accept_awaiter<proto> {
-    return {sock};
+auto async_accept_many(socket<proto> &sock, std::size_t budget = socket<proto>::s_max_batch, async::event e = async::READ) -> detail::async_accept_many_awaiter<proto> {
+    return {sock, budget, e};
 }
 
 template <protocol proto>
@@ -383,6 +1297,98 @@ inline auto async_write(socket<proto> &sock, std::span<char> const buffer) -> de
     return {sock, buffer};
 }
 
+/*
+ * Buffer sequences must outlive the co_await.
+ */
+template <protocol proto>
+inline auto async_readv(socket<proto> &sock, std::span<std::span<char> const> buffers) -> detail::async_vector_awaiter<proto, std::span<char>> {
+    return {sock, buffers, false};
+}
+
+template <protocol proto>
+inline auto async_writev(socket<proto> &sock, std::span<std::span<char const> const> buffers) -> detail::async_vector_awaiter<proto, std::span<char const>> {
+    return {sock, buffers, false};
+}
+
+/*
+ * Complete only once every byte moved, resuming with the total; an error
+ * part-way loses the count of what was already transferred.
+ */
+template <protocol proto>
+inline auto async_read_exact(socket<proto> &sock, std::span<char> buffer) -> detail::async_vector_awaiter<proto, std::span<char>> {
+    return {sock, buffer, true};
+}
+
+template <protocol proto>
+inline auto async_read_exact(socket<proto> &sock, std::span<std::span<char> const> buffers) -> detail::async_vector_awaiter<proto, std::span<char>> {
+    return {sock, buffers, true};
+}
+
+template <protocol proto>
+inline auto async_write_all(socket<proto> &sock, std::span<char const> data) -> detail::async_vector_awaiter<proto, std::span<char const>> {
+    return {sock, data, true};
+}
+
+template <protocol proto>
+inline auto async_write_all(socket<proto> &sock, std::span<std::span<char const> const> buffers) -> detail::async_vector_awaiter<proto, std::span<char const>> {
+    return {sock, buffers, true};
+}
+
+/*
+ * Resumes with 0 bytes at end of stream, like socket::read.
+ */
+template <protocol proto>
+inline auto async_read_with_credentials(socket<proto> &sock, std::span<char> buffer) {
+    return detail::make_datagram_awaiter<credentialed_read>(sock, async::READ | async::RDHANGUP, [buffer](socket<proto> &sock) {
+        return sock.read_with_credentials(buffer);
+    });
+}
+
+template <protocol proto>
+inline auto async_write_with_descriptors(socket<proto> &sock, std::string_view data, std::span<int const> fds) {
+    return detail::make_datagram_awaiter<std::size_t>(sock, async::WRITE, [data, fds](socket<proto> &sock) {
+        return sock.write_with_descriptors(data, fds);
+    });
+}
+
+template <protocol proto>
+inline auto async_read_with_descriptors(socket<proto> &sock, std::span<char> buffer) {
+    return detail::make_datagram_awaiter<descriptor_read>(sock, async::READ | async::RDHANGUP, [buffer](socket<proto> &sock) {
+        return sock.read_with_descriptors(buffer);
+    });
+}
+
+inline auto async_recv_from(socket<protocol::UDP> &sock, std::span<char> buffer) {
+    return detail::make_datagram_awaiter<datagram>(sock, async::READ, [buffer](socket<protocol::UDP> &sock) {
+        return sock.recv_from(buffer);
+    });
+}
+
+inline auto async_send_to(socket<protocol::UDP> &sock, std::span<char const> data, address const &peer) {
+    return detail::make_datagram_awaiter<std::size_t>(sock, async::WRITE, [data, peer](socket<protocol::UDP> &sock) {
+        return sock.send_to(data, peer);
+    });
+}
+
+/*
+ * Resumes with the number of datagrams received into out, at least one.
+ */
+inline auto async_recv_many(socket<protocol::UDP> &sock, std::span<std::span<char> const> buffers, std::span<datagram> out) {
+    return detail::make_datagram_awaiter<std::size_t>(sock, async::READ, [buffers, out](socket<protocol::UDP> &sock) {
+        return sock.recv_many(buffers, out);
+    });
+}
+
+/*
+ * Resumes with the number of datagrams queued, at least one; callers loop
+ * for the rest like with async_write.
+ */
+inline auto async_send_many(socket<protocol::UDP> &sock, std::span<outgoing const> datagrams) {
+    return detail::make_datagram_awaiter<std::size_t>(sock, async::WRITE, [datagrams](socket<protocol::UDP> &sock) {
+        return sock.send_many(datagrams);
+    });
+}
+
 } /* namespace bc::network */
 
 #endif /* __BC_NETWORK_SOCKET_H__ */
@@ -0,0 +1,265 @@
+#pragma once
+
+#ifndef __BC_NETWORK_ZEROCOPY_H__
+#define __BC_NETWORK_ZEROCOPY_H__
+
+// linux/errqueue.h needs struct timespec
+#include <time.h>
+#include <linux/errqueue.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <cerrno>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <span>
+#include <system_error>
+
+#include <bc/utils/error.hpp>
+#include <bc/utils/expected.hpp>
+#include <bc/utils/noncopyable.hpp>
+#include <bc/async/scheduler.hpp>
+#include <bc/async/trace.hpp>
+#include <bc/log/log.hpp>
+
+#include "socket.hpp"
+
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
+
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
+
+namespace bc::network {
+
+struct zerocopy_result {
+    std::size_t bytes;
+    /* the kernel fell back to copying for at least part of the payload */
+    bool copied;
+};
+
+class zerocopy_sender;
+
+namespace detail {
+
+class async_zerocopy_awaiter {
+public:
+    async_zerocopy_awaiter(zerocopy_sender &sender, std::span<char const> data) : sender_(sender), data_(data) {}
+    async_zerocopy_awaiter(async_zerocopy_awaiter const &) = delete;
+
+    auto await_ready() -> bool;
+    auto await_suspend(std::coroutine_handle<> handle) noexcept -> bool;
+    auto await_resume() noexcept -> utils::expected<zerocopy_result, std::error_code>;
+
+private:
+    auto step_() -> bool;
+    auto post_(std::coroutine_handle<> handle) -> void;
+    auto events_() const -> async::event;
+
+private:
+    zerocopy_sender &sender_;
+    std::span<char const> data_;
+    std::size_t done_ {0};
+    bool copied_ {false};
+    bool sending_ {true};
+    /* the last send hit ENOBUFS: the pinned-page budget is spent */
+    bool starved_ {false};
+    std::optional<std::error_code> error_;
+    async::event revent_ {async::NONE};
+};
+
+} /* namespace bc::network::detail */
+
+/*
+ * Sends over a TCP socket with MSG_ZEROCOPY: pages are pinned and handed to
+ * the NIC instead of copied. The kernel reports through the socket error
+ * queue when it no longer needs them, so async_send() resumes only after
+ * those notifications arrive and the buffer may be reused right after the
+ * co_await. One send may be in flight per sender. Small payloads cost more
+ * in page pinning and notifications than the copy they save, and loopback
+ * always copies; copied_sends() shows how often the kernel fell back.
+ */
+class zerocopy_sender : private utils::noncopyable {
+    friend class detail::async_zerocopy_awaiter;
+
+public:
+    explicit zerocopy_sender(socket<protocol::TCP> &sock) : sock_(sock) {
+        int one = 1;
+        if (::setsockopt(sock_.descriptor(), SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == -1) {
+            log::error("failed to enable zerocopy, fd: {}, errno: {}, message: {}", sock_.descriptor(), errno, ::strerror(errno));
+            throw utils::trans_error_code(errno);
+        }
+    }
+
+    auto async_send(std::span<char const> data) -> detail::async_zerocopy_awaiter {
+        return {*this, data};
+    }
+
+    auto sends() const -> std::size_t { return sends_; }
+    auto copied_sends() const -> std::size_t { return copied_sends_; }
+
+private:
+    /*
+     * Consumes queued completions; reports whether the kernel copied.
+     */
+    auto reap_(bool &copied) -> void {
+        while (true) {
+            char control[128];
+            msghdr msg {};
+            msg.msg_control = control;
+            msg.msg_controllen = sizeof(control);
+            if (::recvmsg(sock_.descriptor(), &msg, MSG_ERRQUEUE) == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return;
+            }
+            for (auto *cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+                if (!((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) || (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR))) {
+                    continue;
+                }
+                sock_extended_err err;
+                std::memcpy(&err, CMSG_DATA(cm), sizeof(err));
+                if (err.ee_origin != SO_EE_ORIGIN_ZEROCOPY || err.ee_errno != 0) {
+                    continue;
+                }
+                completed_ += err.ee_data - err.ee_info + 1;
+                if (err.ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+                    copied = true;
+                }
+            }
+        }
+    }
+
+    auto settled_() const -> bool { return completed_ == issued_; }
+
+private:
+    socket<protocol::TCP> &sock_;
+    std::uint32_t issued_ {0};
+    std::uint32_t completed_ {0};
+    std::size_t sends_ {0};
+    std::size_t copied_sends_ {0};
+};
+
+namespace detail {
+
+inline auto async_zerocopy_awaiter::await_ready() -> bool {
+    return step_();
+}
+
+inline auto async_zerocopy_awaiter::await_suspend(std::coroutine_handle<> handle) noexcept -> bool {
+    async::trace::instant("suspend_zerocopy", sender_.sock_.descriptor(), handle.address(), "done", done_);
+    post_(handle);
+    return true;
+}
+
+inline auto async_zerocopy_awaiter::await_resume() noexcept -> utils::expected<zerocopy_result, std::error_code> {
+    if (error_) {
+        return *error_;
+    }
+    ++sender_.sends_;
+    if (copied_) {
+        ++sender_.copied_sends_;
+    }
+    return zerocopy_result {done_, copied_};
+}
+
+/*
+ * While bytes remain, waits for WRITE; afterwards, or while the pinned-page
+ * budget is spent, only for ERROR, which signals a non-empty error queue. The
+ * socket stays writable through ENOBUFS, so waiting for WRITE then would retry
+ * the send on every loop iteration until notifications free the budget.
+ */
+inline auto async_zerocopy_awaiter::events_() const -> async::event {
+    return sending_ && !starved_ ? async::WRITE | async::ERROR | async::HANGUP : async::ERROR | async::HANGUP;
+}
+
+inline auto async_zerocopy_awaiter::post_(std::coroutine_handle<> handle) -> void {
+    auto e = events_();
+    async::default_scheduler().post_coro(sender_.sock_.descriptor(), e, revent_, [this, e, next=handle] {
+        if (!step_()) {
+            if (events_() != e) {
+                post_(next);
+                return true;
+            }
+            return false;
+        }
+        next.resume();
+        return true;
+    });
+}
+
+/*
+ * Returns false while bytes are unsent or completions outstanding.
+ */
+inline auto async_zerocopy_awaiter::step_() -> bool {
+    auto fd = sender_.sock_.descriptor();
+    auto flags = MSG_ZEROCOPY | MSG_NOSIGNAL;
+    while (done_ < data_.size()) {
+        auto res = ::send(fd, data_.data() + done_, data_.size() - done_, flags);
+        if (res == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == ENOBUFS) {
+                auto completed = sender_.completed_;
+                sender_.reap_(copied_);
+                if (sender_.completed_ != completed) {
+                    continue;
+                }
+                if (sender_.settled_()) {
+                    /* none of ours is pinned, so no notification would end the wait: copy */
+                    flags = MSG_NOSIGNAL;
+                    continue;
+                }
+                starved_ = true;
+                return false;
+            }
+            if (errno == EAGAIN) {
+                starved_ = false;
+                sender_.reap_(copied_);
+                return false;
+            }
+            log::error("failed to send zerocopy, fd: {}, errno: {}, message: {}", fd, errno, ::strerror(errno));
+            error_ = utils::trans_error_code(errno == EPIPE ? utils::detail::closed_by_peer : errno);
+            return true;
+        }
+        done_ += res;
+        starved_ = false;
+        if (flags & MSG_ZEROCOPY) {
+            ++sender_.issued_;
+        }
+        else {
+            copied_ = true;
+            flags = MSG_ZEROCOPY | MSG_NOSIGNAL;
+        }
+    }
+    sending_ = false;
+    sender_.reap_(copied_);
+    if (sender_.settled_()) {
+        return true;
+    }
+    /* a pending socket error also raises ERROR and would never clear */
+    int error = 0;
+    socklen_t len = sizeof(error);
+    if ((revent_ & async::ERROR) && ::getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &len) == 0 && error) {
+        error_ = utils::trans_error_code(error);
+        return true;
+    }
+    /* so does a hang-up; what is still queued will never be acknowledged */
+    if (revent_ & async::HANGUP) {
+        error_ = utils::trans_error_code(utils::detail::closed_by_peer);
+        return true;
+    }
+    return false;
+}
+
+} /* namespace bc::network::detail */
+
+} /* namespace bc::network */
+
+#endif /* __BC_NETWORK_ZEROCOPY_H__ */
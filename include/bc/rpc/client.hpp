@@ -0,0 +1,218 @@
+#pragma once
+
+#ifndef __BC_RPC_CLIENT_H__
+#define __BC_RPC_CLIENT_H__
+
+#include <sys/socket.h>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <unordered_map>
+#include <utility>
+
+#include <bc/utils/error.hpp>
+#include <bc/utils/noncopyable.hpp>
+#include <bc/async/scheduler.hpp>
+#include <bc/async/task.hpp>
+#include <bc/log/log.hpp>
+#include <bc/network/address.hpp>
+#include <bc/network/buffered_stream.hpp>
+#include <bc/network/socket.hpp>
+
+#include "frame.hpp"
+
+namespace bc::rpc {
+
+class client;
+
+namespace detail {
+
+class call_awaiter {
+    friend class rpc::client;
+
+public:
+    call_awaiter(client &c, std::uint16_t method, std::string_view payload) : client_(c), method_(method), payload_(payload) {}
+
+    auto await_ready() -> bool;
+    auto await_suspend(std::coroutine_handle<> handle) noexcept -> void {
+        handle_ = handle;
+    }
+    auto await_resume() noexcept -> result {
+        return std::move(res_);
+    }
+
+private:
+    client &client_;
+    std::uint16_t method_;
+    std::string_view payload_;
+    std::coroutine_handle<> handle_;
+    result res_;
+};
+
+} /* namespace bc::rpc::detail */
+
+/*
+ * One connection carrying any number of concurrent calls. Requests issued
+ * while the writer is waiting to run or busy writing are sent together in
+ * one write, and responses resume their callers in whatever order the
+ * server completes them.
+ *
+ * A client belongs to one scheduler and connects once; close() must have
+ * completed before it is destroyed.
+ */
+class client : private utils::noncopyable {
+    friend class detail::call_awaiter;
+
+public:
+    explicit client(options options = {})
+        : options_(options), stream_(sock_, sizeof(std::uint32_t) + detail::s_header_size + options.max_payload), writer_(sock_) {}
+
+    ~client() {
+        if (connected_ && !writing_.done()) {
+            log::error("rpc client destroyed while open, fd: {}", sock_.descriptor());
+        }
+    }
+
+    auto connect(network::address const &addr) -> async::task<std::error_code> {
+        if (auto ec = co_await sock_.async_connect(addr)) {
+            co_return ec;
+        }
+        connected_ = open_ = true;
+        writing_ = writer_.run();
+        reading_ = read_();
+        co_return std::error_code {};
+    }
+
+    /*
+     * Resumes with the response payload. payload is copied before the
+     * caller suspends; one above max_payload fails the call with
+     * message_size without being sent, as the server would drop the
+     * connection, and every other call with it, on reading it.
+     */
+    auto call(std::uint16_t method, std::string_view payload) -> detail::call_awaiter {
+        return {*this, method, payload};
+    }
+
+    /*
+     * Fails the calls in flight with connection_aborted and waits for the
+     * connection's coroutines to finish.
+     */
+    auto close() -> async::task<> {
+        closing_ = true;
+        if (connected_) {
+            ::shutdown(sock_.descriptor(), SHUT_RDWR);
+            co_await reading_;
+            co_await writing_;
+        }
+    }
+
+    auto in_flight() const -> std::size_t { return calls_.size(); }
+    auto is_open() const -> bool { return open_ && !closing_; }
+
+private:
+    auto send_(detail::call_awaiter &call) -> void {
+        // skip ids still in flight after the counter wraps
+        while (calls_.contains(next_stream_)) {
+            ++next_stream_;
+        }
+        auto stream = next_stream_++;
+        calls_.emplace(stream, &call);
+        writer_.push({.stream = stream, .method = call.method_}, call.payload_);
+    }
+
+    auto read_() -> async::task<> {
+        std::error_code ec;
+        while (true) {
+            auto frame = co_await stream_.read_frame<std::uint32_t>();
+            if (!frame) {
+                ec = frame.error();
+                break;
+            }
+            frame_header header;
+            auto payload = detail::decode(*frame, header);
+            if (!payload || header.kind != frame_kind::RESPONSE) {
+                ec = utils::trans_error_code(utils::detail::bad_message);
+                break;
+            }
+            auto it = calls_.find(header.stream);
+            if (it == calls_.end()) {
+                log::warning("response to no call, fd: {}, stream: {}", sock_.descriptor(), header.stream);
+                continue;
+            }
+            auto *call = it->second;
+            calls_.erase(it);
+            switch (header.status) {
+            case status::OK:
+                call->res_ = std::string(*payload);
+                break;
+            case status::UNKNOWN_METHOD:
+                call->res_ = utils::trans_error_code(utils::detail::function_not_implemented);
+                break;
+            default:
+                log::debug("remote call failed, method: {}, message: {}", header.method, *payload);
+                call->res_ = utils::trans_error_code(utils::detail::remote_error);
+                break;
+            }
+            resume_(*call);
+        }
+        if (closing_) {
+            ec = utils::trans_error_code(utils::detail::connection_aborted);
+        }
+        else {
+            log::warning("rpc connection lost, fd: {}, message: {}", sock_.descriptor(), ec.message());
+        }
+        open_ = false;
+        writer_.close();
+        for (auto [stream, call] : calls_) {
+            call->res_ = ec;
+            resume_(*call);
+        }
+        calls_.clear();
+    }
+
+    /*
+     * From the scheduler, so that a caller issuing its next call does not
+     * run inside the reader.
+     */
+    auto resume_(detail::call_awaiter &call) -> void {
+        auto &scheduler = async::default_scheduler();
+        scheduler.post_coro(scheduler.now(), call.handle_);
+    }
+
+private:
+    options options_;
+    network::socket<network::protocol::TCP> sock_;
+    network::buffered_stream<network::socket<network::protocol::TCP>> stream_;
+    detail::frame_writer writer_;
+    std::unordered_map<std::uint32_t, detail::call_awaiter *> calls_;
+    std::uint32_t next_stream_ {0};
+    bool connected_ {false};
+    bool open_ {false};
+    bool closing_ {false};
+    async::task<> reading_;
+    async::task<> writing_;
+};
+
+namespace detail {
+
+inline auto call_awaiter::await_ready() -> bool {
+    if (!client_.open_ || client_.closing_) {
+        res_ = utils::trans_error_code(utils::detail::not_connected);
+        return true;
+    }
+    if (payload_.size() > client_.options_.max_payload) {
+        res_ = utils::trans_error_code(utils::detail::message_size);
+        return true;
+    }
+    client_.send_(*this);
+    return false;
+}
+
+} /* namespace bc::rpc::detail */
+
+} /* namespace bc::rpc */
+
+#endif /* __BC_RPC_CLIENT_H__ */
@@ -0,0 +1,204 @@
+#pragma once
+
+#ifndef __BC_RPC_FRAME_H__
+#define __BC_RPC_FRAME_H__
+
+#include <sys/socket.h>
+#include <bit>
+#include <concepts>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+#include <bc/utils/error.hpp>
+#include <bc/utils/expected.hpp>
+#include <bc/utils/noncopyable.hpp>
+#include <bc/async/scheduler.hpp>
+#include <bc/async/task.hpp>
+#include <bc/log/log.hpp>
+#include <bc/network/socket.hpp>
+
+namespace bc::rpc {
+
+/*
+ * What a handler returns and a call resumes with: the response payload, or
+ * why there is none.
+ */
+using result = utils::expected<std::string, std::error_code>;
+
+enum class frame_kind : std::uint8_t {
+    REQUEST,
+    RESPONSE,
+};
+
+enum class status : std::uint8_t {
+    OK,
+    /* no handler for the method id; the call fails with function_not_implemented */
+    UNKNOWN_METHOD,
+    /* the handler returned an error, whose message is the payload */
+    FAILED,
+};
+
+/*
+ * On the wire a frame is a big-endian u32 length of everything after it,
+ * then the stream id (u32), method id (u16), kind and status (u8 each) and
+ * the payload. The stream id pairs a response with its request, so any
+ * number of calls share a connection and complete in any order.
+ */
+struct frame_header {
+    std::uint32_t stream {0};
+    std::uint16_t method {0};
+    frame_kind kind {frame_kind::REQUEST};
+    rpc::status status {rpc::status::OK};
+};
+
+struct options {
+    /* larger frames fail the connection with message_size */
+    std::size_t max_payload {64 << 10};
+    /* server side: requests run at once per connection before reading pauses */
+    std::size_t max_in_flight {1024};
+};
+
+namespace detail {
+
+/* after the length prefix */
+constexpr std::size_t s_header_size = 8;
+
+template <std::unsigned_integral T>
+inline auto put(char *p, T value) -> char * {
+    if constexpr (std::endian::native == std::endian::little && sizeof(T) > 1) {
+        value = std::byteswap(value);
+    }
+    std::memcpy(p, &value, sizeof(value));
+    return p + sizeof(value);
+}
+
+template <std::unsigned_integral T>
+inline auto get(char const *p) -> T {
+    T value;
+    std::memcpy(&value, p, sizeof(value));
+    if constexpr (std::endian::native == std::endian::little && sizeof(T) > 1) {
+        value = std::byteswap(value);
+    }
+    return value;
+}
+
+/*
+ * Splits what buffered_stream::read_frame<u32>() hands out into header and
+ * payload; fails with bad_message on a frame too short to be one.
+ */
+inline auto decode(std::span<char const> frame, frame_header &header) -> utils::expected<std::string_view, std::error_code> {
+    if (frame.size() < s_header_size) {
+        return utils::trans_error_code(utils::detail::bad_message);
+    }
+    header.stream = get<std::uint32_t>(frame.data());
+    header.method = get<std::uint16_t>(frame.data() + 4);
+    header.kind = static_cast<frame_kind>(frame[6]);
+    header.status = static_cast<status>(frame[7]);
+    return std::string_view(frame.data() + s_header_size, frame.size() - s_header_size);
+}
+
+inline auto encode(std::string &out, frame_header const &header, std::string_view payload) -> void {
+    auto offset = out.size();
+    out.resize(offset + sizeof(std::uint32_t) + s_header_size);
+    auto *p = put(out.data() + offset, static_cast<std::uint32_t>(s_header_size + payload.size()));
+    p = put(p, header.stream);
+    p = put(p, header.method);
+    p = put(p, static_cast<std::uint8_t>(header.kind));
+    put(p, static_cast<std::uint8_t>(header.status));
+    out.append(payload);
+}
+
+/*
+ * Frames queued by any coroutine of a connection and written by one. push()
+ * only appends and schedules the writer, which runs after the current
+ * coroutines yield, so every frame queued in between and while a write is
+ * in flight goes out in the same write.
+ */
+class frame_writer : private utils::noncopyable {
+    class wait_awaiter {
+    public:
+        wait_awaiter(frame_writer &writer) : writer_(writer) {}
+
+        auto await_ready() noexcept -> bool { return false; }
+        auto await_suspend(std::coroutine_handle<> handle) noexcept -> void {
+            writer_.waiter_ = handle;
+        }
+        auto await_resume() noexcept -> void {}
+
+    private:
+        frame_writer &writer_;
+    };
+
+public:
+    frame_writer(network::socket<network::protocol::TCP> &sock) : sock_(sock) {}
+
+    auto push(frame_header const &header, std::string_view payload) -> void {
+        if (failed_) {
+            return;
+        }
+        encode(pending_, header, payload);
+        wake_();
+    }
+
+    /*
+     * Writes until close() and everything pushed before it is out. A failed
+     * write shuts the socket down so that its reader stops as well.
+     */
+    auto run() -> async::task<> {
+        while (true) {
+            if (pending_.empty()) {
+                if (closed_) {
+                    break;
+                }
+                co_await wait_awaiter(*this);
+                continue;
+            }
+            std::swap(pending_, writing_);
+            auto res = co_await network::async_write_all(sock_, writing_);
+            writing_.clear();
+            if (!res) {
+                log::debug("failed to write frames, fd: {}, message: {}", sock_.descriptor(), res.error().message());
+                failed_ = true;
+                pending_.clear();
+                ::shutdown(sock_.descriptor(), SHUT_RDWR);
+                break;
+            }
+        }
+    }
+
+    auto close() -> void {
+        closed_ = true;
+        wake_();
+    }
+
+    auto failed() const -> bool { return failed_; }
+
+private:
+    auto wake_() -> void {
+        if (waiter_) {
+            auto &scheduler = async::default_scheduler();
+            scheduler.post_coro(scheduler.now(), std::exchange(waiter_, nullptr));
+        }
+    }
+
+private:
+    network::socket<network::protocol::TCP> &sock_;
+    std::string pending_;
+    std::string writing_;
+    std::coroutine_handle<> waiter_;
+    bool closed_ {false};
+    bool failed_ {false};
+};
+
+} /* namespace bc::rpc::detail */
+
+} /* namespace bc::rpc */
+
+#endif /* __BC_RPC_FRAME_H__ */
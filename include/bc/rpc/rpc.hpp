@@ -0,0 +1,10 @@
+#pragma once
+
+#ifndef __BC_RPC_H__
+#define __BC_RPC_H__
+
+#include "frame.hpp"
+#include "server.hpp"
+#include "client.hpp"
+
+#endif /* __BC_RPC_H__ */
@@ -0,0 +1,277 @@
+#pragma once
+
+#ifndef __BC_RPC_SERVER_H__
+#define __BC_RPC_SERVER_H__
+
+#include <algorithm>
+#include <array>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+
+#include <bc/utils/error.hpp>
+#include <bc/utils/noncopyable.hpp>
+#include <bc/async/reactor.hpp>
+#include <bc/async/scheduler.hpp>
+#include <bc/async/task.hpp>
+#include <bc/log/log.hpp>
+#include <bc/network/buffered_stream.hpp>
+#include <bc/network/server.hpp>
+#include <bc/network/socket.hpp>
+
+#include "frame.hpp"
+
+namespace bc::rpc {
+
+/*
+ * Binds a method id to a handler, a member function of the service or a
+ * function taking the service first. A handler gets the request payload as
+ * a string_view and returns a result, running inline as frames are read,
+ * or an async::task<result>, running concurrently with the other calls of
+ * the connection on a copy of the payload.
+ */
+template <std::uint16_t Id, auto Handler>
+struct method {
+    constexpr static std::uint16_t id = Id;
+    constexpr static auto handler = Handler;
+};
+
+/*
+ * Method ids index arrays of handlers built at compile time, so dispatch is
+ * a bounds check and an indirect call; keep ids small and dense.
+ */
+template <typename Service, typename... Methods>
+class dispatch_table {
+    static_assert(sizeof...(Methods) > 0, "a dispatch table needs methods");
+
+    template <typename Method>
+    constexpr static bool s_async = std::is_same_v<std::invoke_result_t<decltype(Method::handler), Service &, std::string_view>, async::task<result>>;
+
+    template <typename Method>
+    constexpr static bool s_sync = std::is_same_v<std::invoke_result_t<decltype(Method::handler), Service &, std::string_view>, result>;
+
+    static_assert((... && (s_sync<Methods> || s_async<Methods>)), "a handler returns result or async::task<result>");
+
+    constexpr static auto unique_ids() -> bool {
+        std::array<std::uint16_t, sizeof...(Methods)> ids {Methods::id...};
+        std::ranges::sort(ids);
+        return std::ranges::adjacent_find(ids) == ids.end();
+    }
+
+    static_assert(unique_ids(), "method ids must be unique");
+
+public:
+    using service_type = Service;
+    using sync_handler = auto (*)(Service &, std::string_view) -> result;
+    using async_handler = auto (*)(Service &, std::string_view) -> async::task<result>;
+
+    constexpr static std::size_t s_size = std::max({std::size_t {Methods::id}...}) + 1;
+
+    static auto sync(std::uint16_t id) -> sync_handler {
+        return id < s_size ? s_sync_table[id] : nullptr;
+    }
+
+    static auto async(std::uint16_t id) -> async_handler {
+        return id < s_size ? s_async_table[id] : nullptr;
+    }
+
+private:
+    template <auto Handler, typename R>
+    static auto thunk_(Service &service, std::string_view payload) -> R {
+        return std::invoke(Handler, service, payload);
+    }
+
+    template <typename Handler, bool Async>
+    constexpr static auto build_() {
+        std::array<Handler, s_size> table {};
+        ([&] {
+            if constexpr (s_async<Methods> == Async) {
+                table[Methods::id] = &thunk_<Methods::handler, std::conditional_t<Async, async::task<result>, result>>;
+            }
+        }(), ...);
+        return table;
+    }
+
+    constexpr static std::array<sync_handler, s_size> s_sync_table = build_<sync_handler, false>();
+    constexpr static std::array<async_handler, s_size> s_async_table = build_<async_handler, true>();
+};
+
+namespace detail {
+
+/*
+ * One served connection: reads requests, runs them through the table and
+ * queues responses on the writer as they complete, in whatever order.
+ */
+template <typename Table>
+class connection : private utils::noncopyable {
+    using service_type = typename Table::service_type;
+
+    class wait_awaiter {
+    public:
+        wait_awaiter(connection &conn) : conn_(conn) {}
+
+        auto await_ready() noexcept -> bool { return false; }
+        auto await_suspend(std::coroutine_handle<> handle) noexcept -> void {
+            conn_.waiter_ = handle;
+        }
+        auto await_resume() noexcept -> void {}
+
+    private:
+        connection &conn_;
+    };
+
+public:
+    connection(network::socket<network::protocol::TCP> &sock, service_type &service, options const &options)
+        : sock_(sock), stream_(sock, sizeof(std::uint32_t) + s_header_size + options.max_payload), writer_(sock), service_(service), options_(options) {}
+
+    auto run() -> async::task<> {
+        auto writing = writer_.run();
+        while (true) {
+            while (running_ >= options_.max_in_flight) {
+                co_await wait_awaiter(*this);
+            }
+            auto frame = co_await stream_.template read_frame<std::uint32_t>();
+            if (!frame) {
+                log::debug("connection ends, fd: {}, message: {}", sock_.descriptor(), frame.error().message());
+                break;
+            }
+            frame_header header;
+            auto payload = decode(*frame, header);
+            if (!payload || header.kind != frame_kind::REQUEST) {
+                log::warning("malformed request frame, fd: {}", sock_.descriptor());
+                break;
+            }
+            dispatch_(header, *payload);
+        }
+        // calls hold on to the connection until they are done
+        while (running_ > 0) {
+            co_await wait_awaiter(*this);
+        }
+        writer_.close();
+        co_await writing;
+    }
+
+private:
+    auto dispatch_(frame_header header, std::string_view payload) -> void {
+        header.kind = frame_kind::RESPONSE;
+        if (auto f = Table::sync(header.method)) {
+            respond_(header, f(service_, payload));
+        }
+        else if (auto f = Table::async(header.method)) {
+            if (calls_.size() > running_) {
+                calls_.remove_if([](async::task<> const &call) { return call.done(); });
+            }
+            ++running_;
+            calls_.push_back(call_(f, header, std::string(payload)));
+        }
+        else {
+            header.status = status::UNKNOWN_METHOD;
+            writer_.push(header, {});
+        }
+    }
+
+    auto call_(typename Table::async_handler f, frame_header header, std::string payload) -> async::task<> {
+        respond_(header, co_await f(service_, payload));
+        --running_;
+        if (waiter_) {
+            auto &scheduler = async::default_scheduler();
+            scheduler.post_coro(scheduler.now(), std::exchange(waiter_, nullptr));
+        }
+    }
+
+    /*
+     * A response the client could not read would cost it the connection,
+     * so one above max_payload fails its call instead.
+     */
+    auto respond_(frame_header header, result const &res) -> void {
+        if (res && res->size() <= options_.max_payload) {
+            writer_.push(header, *res);
+            return;
+        }
+        header.status = status::FAILED;
+        std::error_code ec;
+        if (res) {
+            log::warning("response too large, fd: {}, method: {}, size: {}", sock_.descriptor(), header.method, res->size());
+            ec = utils::trans_error_code(utils::detail::message_size);
+        }
+        else {
+            ec = res.error();
+        }
+        auto message = ec.message();
+        writer_.push(header, std::string_view(message).substr(0, options_.max_payload));
+    }
+
+private:
+    network::socket<network::protocol::TCP> &sock_;
+    network::buffered_stream<network::socket<network::protocol::TCP>> stream_;
+    frame_writer writer_;
+    service_type &service_;
+    options const &options_;
+    // finished calls are reaped lazily; a list never moves a running frame
+    std::list<async::task<>> calls_;
+    std::size_t running_ {0};
+    std::coroutine_handle<> waiter_;
+};
+
+} /* namespace bc::rpc::detail */
+
+/*
+ * Serves the methods of Table on network::server, any number of calls per
+ * connection. The service is shared by every connection, and with a reactor
+ * pool by every reactor thread.
+ */
+template <typename Table, network::domain Domain = network::domain::IPv4>
+class server : private utils::noncopyable {
+    using transport_server = network::server<network::protocol::TCP, Domain>;
+
+public:
+    using service_type = typename Table::service_type;
+
+    server(std::string_view hostname, uint16_t port, service_type &service, options options = {}) : transport_(hostname, port), service_(service), options_(options) {
+        tune_();
+    }
+    server(network::address addr, service_type &service, options options = {}) : transport_(std::move(addr)), service_(service), options_(options) {
+        tune_();
+    }
+
+    auto start() -> void {
+        transport_.start([this](network::socket<network::protocol::TCP> &sock) { return serve_(sock); });
+    }
+
+    auto start(async::reactor_pool &pool, network::accept_mode mode = network::accept_mode::DISPATCH) -> void {
+        transport_.start(pool, [this](network::socket<network::protocol::TCP> &sock) { return serve_(sock); }, mode);
+    }
+
+    /*
+     * The underlying server, for connection limits, socket options and
+     * stats. Peer options replace the TCP_NODELAY set by default.
+     */
+    auto transport() -> transport_server & { return transport_; }
+
+private:
+    auto tune_() -> void {
+        // responses are written in batches already
+        transport_.set_socket_options(network::role::PEER, {.no_delay = true});
+    }
+
+    auto serve_(network::socket<network::protocol::TCP> &sock) -> async::task<> {
+        detail::connection<Table> conn(sock, service_, options_);
+        co_await conn.run();
+    }
+
+private:
+    transport_server transport_;
+    service_type &service_;
+    options options_;
+};
+
+} /* namespace bc::rpc */
+
+#endif /* __BC_RPC_SERVER_H__ */
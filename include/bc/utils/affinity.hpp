@@ -0,0 +1,110 @@
+#pragma once
+
+#ifndef __BC_UTILS_AFFINITY_H__
+#define __BC_UTILS_AFFINITY_H__
+
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <charconv>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "error.hpp"
+
+namespace bc::utils {
+
+struct placement {
+    std::vector<int> cpus;
+    int node {-1};
+};
+
+/*
+ * NUMA node a cpu belongs to, read from sysfs so no libnuma is needed.
+ * Returns -1 on machines or containers that do not expose the topology.
+ */
+inline auto cpu_node(int cpu) -> int {
+    std::error_code ec;
+    auto dir = std::filesystem::path("/sys/devices/system/cpu") / ("cpu" + std::to_string(cpu));
+    for (auto const &entry : std::filesystem::directory_iterator(dir, ec)) {
+        auto name = entry.path().filename().string();
+        int node = -1;
+        if (name.starts_with("node") && std::from_chars(name.data() + 4, name.data() + name.size(), node).ec == std::errc()) {
+            return node;
+        }
+    }
+    return -1;
+}
+
+/*
+ * Node shared by every cpu in the set, -1 if they straddle nodes or the
+ * topology is unknown.
+ */
+inline auto cpus_node(std::span<int const> cpus) -> int {
+    int node = -1;
+    for (auto cpu : cpus) {
+        auto n = cpu_node(cpu);
+        if (n == -1 || (node != -1 && n != node)) {
+            return -1;
+        }
+        node = n;
+    }
+    return node;
+}
+
+inline auto thread_placement(pthread_t thread) -> placement {
+    placement placement;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (::pthread_getaffinity_np(thread, sizeof(set), &set) != 0) {
+        return placement;
+    }
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (CPU_ISSET(cpu, &set)) {
+            placement.cpus.push_back(cpu);
+        }
+    }
+    placement.node = cpus_node(placement.cpus);
+    return placement;
+}
+
+inline auto pin_thread(pthread_t thread, std::span<int const> cpus) -> std::error_code {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (auto cpu : cpus) {
+        if (cpu < 0 || cpu >= CPU_SETSIZE) {
+            return trans_error_code(EINVAL);
+        }
+        CPU_SET(cpu, &set);
+    }
+    if (auto error = ::pthread_setaffinity_np(thread, sizeof(set), &set)) {
+        return trans_error_code(error);
+    }
+    return {};
+}
+
+/*
+ * Makes the calling thread's future page allocations prefer the given node.
+ * Combined with pinning this keeps a reactor's tables and pools node-local.
+ */
+inline auto prefer_node(int node) -> std::error_code {
+    if (node < 0 || node >= static_cast<int>(sizeof(unsigned long) * 8)) {
+        return trans_error_code(EINVAL);
+    }
+    unsigned long mask = 1ul << node;
+    if (::syscall(SYS_set_mempolicy, MPOL_PREFERRED, &mask, sizeof(mask) * 8 + 1) == -1) {
+        return trans_error_code(errno);
+    }
+    return {};
+}
+
+} /* namespace bc::utils */
+
+#endif /* __BC_UTILS_AFFINITY_H__ */
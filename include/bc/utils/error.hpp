@@ -4,6 +4,7 @@
 #define __BC_UTILS_ERROR_H__
 
 #include <cstdlib>
+#include <cstring>
 #include <string>
 #include <system_error>
 
@@ -14,32 +15,52 @@ namespace detail {
 enum errc {
     operation_not_permitted = EPERM, // 1
     no_such_file_or_directory = ENOENT, // 2
+    no_such_process = ESRCH, // 3
     interrupted = EINTR, // 4
     io_error = EIO, // 5
+    argument_list_too_long = E2BIG, // 7
+    executable_format_error = ENOEXEC, // 8
     bad_file_descriptor = EBADF, // 9
+    no_child_process = ECHILD, // 10
+    resource_unavailable_try_again = EAGAIN, // 11
     not_enough_memory = ENOMEM, // 12
     permission_denied = EACCES, // 13
     bad_address = EFAULT, // 14
     file_exists = EEXIST, // 17
     not_a_directory = ENOTDIR, // 20
     invalid_argument = EINVAL, // 22
+    too_many_files_open_in_system = ENFILE, // 23
     too_many_files_open = EMFILE, // 24
     file_too_large = EFBIG, // 27
     no_space_on_device = ENOSPC, // 28
     read_only_file_system = EROFS, // 30
     broken_pipe = EPIPE, // 32
     name_too_long = ENAMETOOLONG, // 36
+    function_not_implemented = ENOSYS, // 38
     too_many_symbolic_link_levels = ELOOP, // 40
+    protocol_error = EPROTO, // 71
+    bad_message = EBADMSG, // 74
     not_a_socket = ENOTSOCK, // 88
     destination_address_required = EDESTADDRREQ, // 89
+    message_size = EMSGSIZE, // 90
     no_protocol_option = ENOPROTOOPT, // 92
     operation_not_supported = EOPNOTSUPP, // 95
     address_in_use = EADDRINUSE, // 98
     address_not_available = EADDRNOTAVAIL, // 99
+    network_unreachable = ENETUNREACH, // 101
+    connection_aborted = ECONNABORTED, // 103
+    connection_reset = ECONNRESET, // 104
+    no_buffer_space = ENOBUFS, // 105
+    not_connected = ENOTCONN, // 107
+    timed_out = ETIMEDOUT, // 110
+    connection_refused = ECONNREFUSED, // 111
+    host_unreachable = EHOSTUNREACH, // 113
     quota_exceeded = EDQUOT, // 122
+    operation_canceled = ECANCELED, // 125
     epoll_error = 200,
     closed_by_peer = 201,
     invalid_address = 202,
+    remote_error = 203,
 };
 
 class bc_error_category : public std::error_category {
@@ -54,12 +75,22 @@ public:
                 return "operation not permitted";
             case no_such_file_or_directory:
                 return "no such file or directory";
+            case no_such_process:
+                return "no such process";
             case interrupted:
                 return "interrupted system call";
             case io_error:
                 return "input/output error";
+            case argument_list_too_long:
+                return "argument list too long";
+            case executable_format_error:
+                return "exec format error";
             case bad_file_descriptor:
                 return "bad file descriptor";
+            case no_child_process:
+                return "no child processes";
+            case resource_unavailable_try_again:
+                return "resource temporarily unavailable";
             case not_enough_memory:
                 return "cannot allocate memory";
             case permission_denied:
@@ -72,6 +103,8 @@ public:
                 return "not a directory";
             case invalid_argument:
                 return "invalid argument";
+            case too_many_files_open_in_system:
+                return "too many open files in system";
             case too_many_files_open:
                 return "too many open files";
             case file_too_large:
@@ -84,10 +117,18 @@ public:
                 return "broken pipe";
             case name_too_long:
                 return "name too long";
+            case function_not_implemented:
+                return "function not implemented";
             case too_many_symbolic_link_levels:
                 return "too many levels of symbolic links";
+            case protocol_error:
+                return "protocol error";
+            case bad_message:
+                return "bad message";
             case not_a_socket:
                 return "socket operation on non-socket";
+            case message_size:
+                return "message too long";
             case destination_address_required:
                 return "destination address required";
             case no_protocol_option:
@@ -98,16 +139,36 @@ public:
                 return "address already in use";
             case address_not_available:
                 return "cannot assign requested address";
+            case network_unreachable:
+                return "network is unreachable";
+            case connection_aborted:
+                return "software caused connection abort";
+            case connection_reset:
+                return "connection reset by peer";
+            case no_buffer_space:
+                return "no buffer space available";
+            case not_connected:
+                return "transport endpoint is not connected";
+            case timed_out:
+                return "connection timed out";
+            case connection_refused:
+                return "connection refused";
+            case host_unreachable:
+                return "no route to host";
             case quota_exceeded:
                 return "quota exceeded";
+            case operation_canceled:
+                return "operation canceled";
             case epoll_error:
                 return "epoll error";
             case closed_by_peer:
                 return "closed by peer";
             case invalid_address:
                 return "invalid address";
+            case remote_error:
+                return "remote call failed";
             default:
-                abort();
+                return ::strerror(condition);
         }
     }
 };
@@ -123,6 +184,10 @@ inline auto trans_error_code(int error) -> std::error_code {
     return std::error_code(error, detail::bc_category());
 }
 
+inline auto would_block(std::error_code const &ec) -> bool {
+    return ec == trans_error_code(detail::resource_unavailable_try_again);
+}
+
 } /* namespace bc::error */
 
 #endif /* __BC_UTILS_ERROR_H__ */
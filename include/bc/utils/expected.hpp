@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cassert>
 #include <concepts>
 #include <functional>
 #include <type_traits>
@@ -59,6 +60,11 @@ public:
     template <typename ...Args>
     expected(unexpect_t, Args &&...args) : value_(E {std::forward<Args>(args)...}) {}
 
+    auto operator =(expected &&other) -> expected & {
+        value_ = std::move(other.value_);
+        return *this;
+    }
+
     template< class U = T >
     auto operator =(U &&v) -> expected & {
         value_ = std::forward<U>(v);
@@ -67,11 +73,11 @@ public:
 
     auto operator->() const noexcept -> T const * {
         assert(has_value());
-        return std::get<T>(value_);
+        return &std::get<T>(value_);
     }
     auto operator->() noexcept -> T * {
         assert(has_value());
-        return std::get<T>(value_);
+        return &std::get<T>(value_);
     }
 
     auto operator *() const & noexcept -> T const & {
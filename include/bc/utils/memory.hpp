@@ -0,0 +1,146 @@
+#pragma once
+
+#ifndef __BC_UTILS_MEMORY_H__
+#define __BC_UTILS_MEMORY_H__
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <string_view>
+#include <utility>
+
+/*
+ * Process-wide accounting of memory held by each subsystem. Every category is
+ * a few relaxed atomics on its own cache line, so the counters stay on in
+ * production; peaks are high-water marks since start or the last reset.
+ */
+namespace bc::utils::memory {
+
+enum class category {
+    COROUTINE_FRAMES,
+    SCHEDULER,
+    SOCKET_BUFFERS,
+    LOG_RECORDS,
+    LOG_FORMATTER,
+    COUNT,
+};
+
+struct usage {
+    std::size_t bytes;
+    std::size_t objects;
+    std::size_t peak_bytes;
+    std::size_t peak_objects;
+};
+
+namespace detail {
+
+struct alignas(64) counter {
+    std::atomic_size_t bytes {0};
+    std::atomic_size_t objects {0};
+    std::atomic_size_t peak_bytes {0};
+    std::atomic_size_t peak_objects {0};
+};
+
+inline std::array<counter, std::to_underlying(category::COUNT)> g_counters;
+
+inline auto raise_peak(std::atomic_size_t &peak, std::size_t value) noexcept -> void {
+    auto current = peak.load(std::memory_order_relaxed);
+    while (value > current && !peak.compare_exchange_weak(current, value, std::memory_order_relaxed)) {}
+}
+
+} /* namespace bc::utils::memory::detail */
+
+inline auto add(category c, std::size_t bytes, std::size_t objects = 1) noexcept -> void {
+    auto &counter = detail::g_counters[std::to_underlying(c)];
+    detail::raise_peak(counter.peak_bytes, counter.bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes);
+    detail::raise_peak(counter.peak_objects, counter.objects.fetch_add(objects, std::memory_order_relaxed) + objects);
+}
+
+inline auto sub(category c, std::size_t bytes, std::size_t objects = 1) noexcept -> void {
+    auto &counter = detail::g_counters[std::to_underlying(c)];
+    counter.bytes.fetch_sub(bytes, std::memory_order_relaxed);
+    counter.objects.fetch_sub(objects, std::memory_order_relaxed);
+}
+
+inline auto current(category c) noexcept -> usage {
+    auto const &counter = detail::g_counters[std::to_underlying(c)];
+    return {
+        counter.bytes.load(std::memory_order_relaxed),
+        counter.objects.load(std::memory_order_relaxed),
+        counter.peak_bytes.load(std::memory_order_relaxed),
+        counter.peak_objects.load(std::memory_order_relaxed),
+    };
+}
+
+inline auto snapshot() noexcept -> std::array<usage, std::to_underlying(category::COUNT)> {
+    std::array<usage, std::to_underlying(category::COUNT)> usages;
+    for (std::size_t i = 0; i < usages.size(); ++i) {
+        usages[i] = current(static_cast<category>(i));
+    }
+    return usages;
+}
+
+/*
+ * Lowers every peak to the current value, to measure a window.
+ */
+inline auto reset_peaks() noexcept -> void {
+    for (auto &counter : detail::g_counters) {
+        counter.peak_bytes.store(counter.bytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        counter.peak_objects.store(counter.objects.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+}
+
+inline auto category_name(category c) -> std::string_view {
+    switch (c) {
+        case category::COROUTINE_FRAMES:
+            return "coroutine_frames";
+        case category::SCHEDULER:
+            return "scheduler";
+        case category::SOCKET_BUFFERS:
+            return "socket_buffers";
+        case category::LOG_RECORDS:
+            return "log_records";
+        case category::LOG_FORMATTER:
+            return "log_formatter";
+        default:
+            return "unknown";
+    }
+}
+
+/*
+ * Standard allocator charging every block to a category; each allocation is
+ * one object.
+ */
+template <typename T, category C>
+struct allocator {
+    using value_type = T;
+
+    template <typename U>
+    struct rebind {
+        using other = allocator<U, C>;
+    };
+
+    allocator() = default;
+    template <typename U>
+    allocator(allocator<U, C> const &) noexcept {}
+
+    auto allocate(std::size_t n) -> T * {
+        auto p = std::allocator<T> {}.allocate(n);
+        add(C, n * sizeof(T));
+        return p;
+    }
+
+    auto deallocate(T *p, std::size_t n) noexcept -> void {
+        sub(C, n * sizeof(T));
+        std::allocator<T> {}.deallocate(p, n);
+    }
+
+    template <typename U>
+    auto operator==(allocator<U, C> const &) const noexcept -> bool { return true; }
+};
+
+} /* namespace bc::utils::memory */
+
+#endif /* __BC_UTILS_MEMORY_H__ */
@@ -0,0 +1,469 @@
+#include <linux/io_uring.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <bc/async/file.hpp>
+
+namespace bc::async {
+
+namespace {
+
+auto run_op(detail::file_op &op) -> ssize_t {
+    while (true) {
+        ssize_t res = 0;
+        switch (op.kind) {
+        case detail::file_op::kind::READ:
+            res = ::pread(op.fd, op.data, op.size, op.offset);
+            break;
+        case detail::file_op::kind::WRITE:
+            res = ::pwrite(op.fd, op.data, op.size, op.offset);
+            break;
+        case detail::file_op::kind::FSYNC:
+            res = ::fsync(op.fd);
+            break;
+        case detail::file_op::kind::FDATASYNC:
+            res = ::fdatasync(op.fd);
+            break;
+        }
+        if (res == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -errno;
+        }
+        return res;
+    }
+}
+
+/*
+ * Minimal io_uring driven through the raw syscalls. Only the issuing thread
+ * touches the rings, so head and tail need no more than acquire/release.
+ */
+class uring : private utils::noncopyable {
+public:
+    constexpr static unsigned s_entries = 256;
+
+    static auto create() -> std::unique_ptr<uring> {
+        io_uring_params params {};
+        int fd = ::syscall(__NR_io_uring_setup, s_entries, &params);
+        if (fd == -1) {
+            log::info("io_uring unavailable, errno: {}, message: {}", errno, ::strerror(errno));
+            return nullptr;
+        }
+        auto ring = std::make_unique<uring>();
+        ring->fd_ = fd;
+        ring->sq_len_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        ring->cq_len_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (single) {
+            ring->sq_len_ = ring->cq_len_ = std::max(ring->sq_len_, ring->cq_len_);
+        }
+        ring->sq_ptr_ = ::mmap(nullptr, ring->sq_len_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        if (ring->sq_ptr_ == MAP_FAILED) {
+            log::error("failed to map io_uring sq, errno: {}, message: {}", errno, ::strerror(errno));
+            return nullptr;
+        }
+        ring->cq_ptr_ = single ? ring->sq_ptr_ : ::mmap(nullptr, ring->cq_len_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (ring->cq_ptr_ == MAP_FAILED) {
+            log::error("failed to map io_uring cq, errno: {}, message: {}", errno, ::strerror(errno));
+            return nullptr;
+        }
+        ring->sqes_len_ = params.sq_entries * sizeof(io_uring_sqe);
+        auto sqes = ::mmap(nullptr, ring->sqes_len_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED) {
+            log::error("failed to map io_uring sqes, errno: {}, message: {}", errno, ::strerror(errno));
+            return nullptr;
+        }
+        ring->sqes_ = static_cast<io_uring_sqe *>(sqes);
+
+        auto sq = static_cast<char *>(ring->sq_ptr_);
+        ring->sq_head_ = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+        ring->sq_tail_ = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+        ring->sq_mask_ = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+        ring->sq_entries_ = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_entries);
+        ring->sq_array_ = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+
+        auto cq = static_cast<char *>(ring->cq_ptr_);
+        ring->cq_head_ = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+        ring->cq_tail_ = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+        ring->cq_mask_ = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+        ring->cq_entries_ = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_entries);
+        ring->cqes_ = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+        return ring;
+    }
+
+public:
+    uring() = default;
+    ~uring() {
+        if (sqes_) {
+            ::munmap(sqes_, sqes_len_);
+        }
+        if (cq_ptr_ && cq_ptr_ != MAP_FAILED && cq_ptr_ != sq_ptr_) {
+            ::munmap(cq_ptr_, cq_len_);
+        }
+        if (sq_ptr_ && sq_ptr_ != MAP_FAILED) {
+            ::munmap(sq_ptr_, sq_len_);
+        }
+        if (fd_ != -1) {
+            ::close(fd_);
+        }
+    }
+
+    /*
+     * Queues the operations and submits as many as the completion ring can
+     * take; the rest go out from reap() as completions free room.
+     */
+    auto submit(std::span<detail::file_op> ops) -> void {
+        for (auto &op : ops) {
+            backlog_.push_back(&op);
+        }
+        flush_();
+    }
+
+    template <typename F>
+    auto reap(F &&f) -> void {
+        auto head = *cq_head_;
+        auto tail = std::atomic_ref(*cq_tail_).load(std::memory_order_acquire);
+        while (head != tail) {
+            auto const &cqe = cqes_[head & cq_mask_];
+            f(reinterpret_cast<detail::file_op *>(cqe.user_data), cqe.res);
+            ++head;
+            --submitted_;
+        }
+        std::atomic_ref(*cq_head_).store(head, std::memory_order_release);
+        flush_();
+    }
+
+    auto descriptor() const -> int { return fd_; }
+
+private:
+    /*
+     * Never has more operations in the kernel than the completion ring holds,
+     * so it cannot overflow while only this thread reaps it.
+     */
+    auto flush_() -> void {
+        while (!backlog_.empty() && submitted_ + queued_ < cq_entries_) {
+            auto tail = *sq_tail_;
+            if (tail - std::atomic_ref(*sq_head_).load(std::memory_order_acquire) == sq_entries_) {
+                if (!enter_()) {
+                    return;
+                }
+                continue;
+            }
+            auto &op = *backlog_.front();
+            backlog_.pop_front();
+            auto index = tail & sq_mask_;
+            auto *sqe = &sqes_[index];
+            std::memset(sqe, 0, sizeof(*sqe));
+            sqe->fd = op.fd;
+            sqe->user_data = reinterpret_cast<std::uint64_t>(&op);
+            switch (op.kind) {
+            case detail::file_op::kind::READ:
+                sqe->opcode = IORING_OP_READ;
+                break;
+            case detail::file_op::kind::WRITE:
+                sqe->opcode = IORING_OP_WRITE;
+                break;
+            case detail::file_op::kind::FSYNC:
+                sqe->opcode = IORING_OP_FSYNC;
+                break;
+            case detail::file_op::kind::FDATASYNC:
+                sqe->opcode = IORING_OP_FSYNC;
+                sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+                break;
+            }
+            sqe->off = op.offset;
+            sqe->addr = reinterpret_cast<std::uint64_t>(op.data);
+            sqe->len = op.size;
+            sq_array_[index] = index;
+            std::atomic_ref(*sq_tail_).store(tail + 1, std::memory_order_release);
+            ++queued_;
+        }
+        enter_();
+    }
+
+    /*
+     * Returns false when the kernel pushed back with entries still queued.
+     * Those are retried after the next reap, which is what frees room; only
+     * with nothing in flight, and so nothing to reap, is it worth spinning.
+     */
+    auto enter_() -> bool {
+        while (queued_) {
+            auto res = ::syscall(__NR_io_uring_enter, fd_, queued_, 0, 0, nullptr, 0);
+            if (res == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno == EAGAIN || errno == EBUSY) {
+                    if (submitted_ == 0) {
+                        continue;
+                    }
+                    return false;
+                }
+                log::error("failed to enter io_uring, errno: {}, message: {}", errno, ::strerror(errno));
+                throw utils::trans_error_code(errno);
+            }
+            queued_ -= res;
+            submitted_ += res;
+        }
+        return true;
+    }
+
+private:
+    int fd_ {-1};
+    void *sq_ptr_ {nullptr};
+    void *cq_ptr_ {nullptr};
+    std::size_t sq_len_ {0};
+    std::size_t cq_len_ {0};
+    std::size_t sqes_len_ {0};
+    unsigned *sq_head_ {nullptr};
+    unsigned *sq_tail_ {nullptr};
+    unsigned sq_mask_ {0};
+    unsigned sq_entries_ {0};
+    unsigned cq_entries_ {0};
+    unsigned *sq_array_ {nullptr};
+    io_uring_sqe *sqes_ {nullptr};
+    unsigned *cq_head_ {nullptr};
+    unsigned *cq_tail_ {nullptr};
+    unsigned cq_mask_ {0};
+    io_uring_cqe *cqes_ {nullptr};
+    /* written to the submission ring but not yet entered */
+    unsigned queued_ {0};
+    /* entered and not reaped yet */
+    unsigned submitted_ {0};
+    std::deque<detail::file_op *> backlog_;
+};
+
+class engine;
+
+/*
+ * Process-wide threads running blocking file syscalls for engines without
+ * io_uring. Results travel back through the owning engine's eventfd.
+ */
+class io_threads : private utils::noncopyable {
+public:
+    constexpr static std::size_t s_threads = 4;
+
+    static auto instance() -> io_threads & {
+        static io_threads s_instance;
+        return s_instance;
+    }
+
+    auto submit(engine *owner, std::span<detail::file_op> ops) -> void {
+        {
+            std::unique_lock lock(mutex_);
+            for (auto &op : ops) {
+                jobs_.emplace_back(owner, &op);
+            }
+        }
+        if (ops.size() == 1) {
+            cv_.notify_one();
+        }
+        else {
+            cv_.notify_all();
+        }
+    }
+
+private:
+    io_threads() {
+        for (std::size_t i = 0; i < s_threads; ++i) {
+            threads_.emplace_back([this](std::stop_token token) { loop_(token); });
+        }
+    }
+    ~io_threads() {
+        for (auto &thread : threads_) {
+            thread.request_stop();
+        }
+        cv_.notify_all();
+    }
+
+    auto loop_(std::stop_token token) -> void;
+
+private:
+    std::mutex mutex_;
+    std::condition_variable_any cv_;
+    std::deque<std::pair<engine *, detail::file_op *>> jobs_;
+    std::vector<std::jthread> threads_;
+};
+
+/*
+ * Per-thread owner of in-flight file operations. Its completion descriptor
+ * (the ring, or an eventfd for the thread pool) is registered with the
+ * scheduler only while something is in flight, so an idle engine never keeps
+ * run() alive.
+ */
+class engine : private utils::noncopyable {
+public:
+    engine(file_backend preferred) {
+        if (preferred == file_backend::IO_URING) {
+            ring_ = uring::create();
+        }
+        if (ring_) {
+            backend_ = file_backend::IO_URING;
+            notify_fd_ = ring_->descriptor();
+            return;
+        }
+        backend_ = file_backend::THREAD_POOL;
+        notify_fd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (notify_fd_ == -1) {
+            log::error("failed to create eventfd, errno: {}, message: {}", errno, ::strerror(errno));
+            throw utils::trans_error_code(errno);
+        }
+    }
+    /*
+     * An engine dies with its thread, possibly with operations still on the
+     * I/O threads; wait for them so that none completes into freed memory.
+     */
+    ~engine() {
+        if (backend_ == file_backend::THREAD_POOL) {
+            std::unique_lock lock(mutex_);
+            drained_.wait(lock, [this] { return outstanding_ == 0; });
+            ::close(notify_fd_);
+        }
+    }
+
+    auto backend() const -> file_backend { return backend_; }
+
+    auto submit(std::span<detail::file_op> ops) -> void {
+        inflight_ += ops.size();
+        arm_();
+        if (ring_) {
+            ring_->submit(ops);
+        }
+        else {
+            {
+                std::unique_lock lock(mutex_);
+                outstanding_ += ops.size();
+            }
+            io_threads::instance().submit(this, ops);
+        }
+    }
+
+    /*
+     * Called from an I/O thread. Everything happens under the lock, the
+     * destructor's last chance to see the engine still in use.
+     */
+    auto complete(detail::file_op *op) -> void {
+        std::unique_lock lock(mutex_);
+        completed_.push_back(op);
+        std::uint64_t one = 1;
+        while (::write(notify_fd_, &one, sizeof(one)) == -1 && errno == EINTR) {}
+        if (--outstanding_ == 0) {
+            drained_.notify_all();
+        }
+    }
+
+private:
+    auto arm_() -> void {
+        if (armed_) {
+            return;
+        }
+        armed_ = true;
+        default_scheduler().post_coro(notify_fd_, READ, revent_, [this] {
+            return reap_();
+        });
+    }
+
+    auto reap_() -> bool {
+        ready_.clear();
+        if (ring_) {
+            ring_->reap([this](detail::file_op *op, int res) {
+                op->result = res;
+                ready_.push_back(op);
+            });
+        }
+        else {
+            std::uint64_t count;
+            while (::read(notify_fd_, &count, sizeof(count)) == -1 && errno == EINTR) {}
+            std::unique_lock lock(mutex_);
+            ready_.swap(completed_);
+        }
+        inflight_ -= ready_.size();
+        /* resumed coroutines may submit again, which only touches inflight_ */
+        auto ready = std::move(ready_);
+        for (auto *op : ready) {
+            if (--*op->pending == 0) {
+                op->next.resume();
+            }
+        }
+        ready_ = std::move(ready);
+        if (inflight_ == 0) {
+            armed_ = false;
+            return true;
+        }
+        return false;
+    }
+
+private:
+    file_backend backend_;
+    std::unique_ptr<uring> ring_;
+    int notify_fd_ {-1};
+    std::size_t inflight_ {0};
+    bool armed_ {false};
+    event revent_ {NONE};
+    std::mutex mutex_;
+    std::condition_variable drained_;
+    /* handed to the I/O threads and not completed yet */
+    std::size_t outstanding_ {0};
+    std::vector<detail::file_op *> completed_;
+    std::vector<detail::file_op *> ready_;
+};
+
+auto io_threads::loop_(std::stop_token token) -> void {
+    while (true) {
+        std::pair<engine *, detail::file_op *> job;
+        {
+            std::unique_lock lock(mutex_);
+            if (!cv_.wait(lock, token, [this] { return !jobs_.empty(); })) {
+                return;
+            }
+            job = jobs_.front();
+            jobs_.pop_front();
+        }
+        job.second->result = run_op(*job.second);
+        job.first->complete(job.second);
+    }
+}
+
+thread_local file_backend t_preferred {file_backend::IO_URING};
+thread_local std::unique_ptr<engine> t_engine;
+
+auto local_engine() -> engine & {
+    if (!t_engine) {
+        t_engine = std::make_unique<engine>(t_preferred);
+    }
+    return *t_engine;
+}
+
+}
+
+auto set_file_backend(file_backend backend) -> void {
+    t_preferred = backend;
+}
+
+auto current_file_backend() -> file_backend {
+    return local_engine().backend();
+}
+
+namespace detail {
+
+auto submit_file_ops(std::span<file_op> ops) -> void {
+    local_engine().submit(ops);
+}
+
+auto perform_file_op(file_op &op) -> void {
+    op.result = run_op(op);
+}
+
+} /* namespace bc::async::detail */
+
+} /* namespace bc::async */
@@ -0,0 +1,77 @@
+#include <algorithm>
+#include <limits>
+
+#include <bc/async/reactor.hpp>
+
+namespace bc::async {
+
+reactor::reactor(std::vector<int> cpus) {
+    scheduler_.set_affinity(std::move(cpus));
+    thread_ = std::jthread(&reactor::loop_, this);
+}
+
+reactor::~reactor() {
+    stop();
+}
+
+auto reactor::stop() -> void {
+    if (!stopped_.exchange(true)) {
+        scheduler_.close_mailbox();
+    }
+}
+
+auto reactor::load(load_metric metric) const -> std::uint64_t {
+    switch (metric) {
+        case load_metric::SESSIONS:
+            return sessions_.load(std::memory_order_relaxed);
+        case load_metric::LATENCY:
+            return scheduler_.load().count();
+    }
+    return 0;
+}
+
+auto reactor::loop_() -> void {
+    set_default_scheduler(scheduler_);
+    scheduler_.open_mailbox();
+    scheduler_.run();
+    reset_default_scheduler();
+    log::debug("reactor thread exits");
+}
+
+reactor_pool::reactor_pool(std::size_t count, load_metric metric) : metric_(metric) {
+    for (std::size_t i = 0; i < count; ++i) {
+        reactors_.push_back(std::make_unique<reactor>());
+    }
+}
+
+reactor_pool::reactor_pool(std::vector<std::vector<int>> const &cpus, load_metric metric) : metric_(metric) {
+    for (auto const &set : cpus) {
+        reactors_.push_back(std::make_unique<reactor>(set));
+    }
+}
+
+auto reactor_pool::least_loaded() const -> std::size_t {
+    assert(!reactors_.empty());
+    // start from a rotating offset so ties are spread instead of always
+    // landing on the first reactor
+    auto start = next_.fetch_add(1, std::memory_order_relaxed);
+    std::size_t index = 0;
+    auto least = std::numeric_limits<std::uint64_t>::max();
+    for (std::size_t n = 0; n < reactors_.size(); ++n) {
+        auto i = (start + n) % reactors_.size();
+        auto load = reactors_[i]->load(metric_);
+        if (load < least) {
+            least = load;
+            index = i;
+        }
+    }
+    return index;
+}
+
+auto reactor_pool::stop() -> void {
+    for (auto &reactor : reactors_) {
+        reactor->stop();
+    }
+}
+
+} /* namespace bc::async */
@@ -1,6 +1,8 @@
 #include <bits/chrono.h>
 #include <sys/epoll.h>
+#include <pthread.h>
 #include <cerrno>
+#include <fmt/ranges.h>
 
 #include <bc/async/scheduler.hpp>
 #include <thread>
@@ -29,6 +31,18 @@ auto poller::subscribe(int fd, event e) -> void {
             .fd = fd,
         },
     };
+    if (op) {
+        constexpr char const *s_names[] {"", "epoll_ctl_add", "epoll_ctl_del", "epoll_ctl_mod"};
+        trace::instant(s_names[op], fd, nullptr, "events", e);
+    }
+    // exclusive registrations cannot be modified, only removed and added again
+    if (op == EPOLL_CTL_MOD && ((focus_[fd] | e) & EXCLUSIVE)) {
+        if (::epoll_ctl(epfd_, EPOLL_CTL_DEL, fd, nullptr) == -1) {
+            log::error("epoll_ctl failed, op: {}, fd: {}, event: {}", EPOLL_CTL_DEL, fd, e);
+            throw utils::trans_error_code(errno);
+        }
+        op = EPOLL_CTL_ADD;
+    }
     if (op && ::epoll_ctl(epfd_, op, fd, &ev) == -1) {
         log::error("epoll_ctl failed, op: {}, fd: {}, event: {}", op, fd, e);
         throw utils::trans_error_code(errno);
@@ -36,19 +50,56 @@ auto poller::subscribe(int fd, event e) -> void {
     focus_[fd] = e;
 }
 
-auto scheduler::run() -> void {
+auto fake_poller::subscribe(int fd, event e) -> void {
+    log::debug("fake subscribe, fd: {}, event: {}", fd, e);
+    assert(fd > 0);
+    if (focus_.size() <= static_cast<std::size_t>(fd)) {
+        focus_.resize(std::bit_ceil(static_cast<std::size_t>(fd) + 1), NONE);
+    }
+    focus_[fd] = e;
+}
+
+auto fake_poller::inject(int fd, event e) -> void {
+    log::debug("inject fake event, fd: {}, event: {}", fd, e);
+    assert(fd > 0);
+    pending_[fd] |= e;
+}
+
+auto fake_poller::deliverable() const -> bool {
+    return std::ranges::any_of(pending_, [&](auto const &pending) {
+        return matched_(pending.first, pending.second) != NONE;
+    });
+}
+
+scheduler::~scheduler() noexcept {
+    if (mailbox_fd_ != -1 && ::close(mailbox_fd_) == -1) {
+        log::error("failed to close mailbox fd, fd: {}, errno: {}, message: {}", mailbox_fd_, errno, ::strerror(errno));
+    }
+}
+
+auto scheduler::run_until(time_point deadline) -> void {
+    place_();
     while (coro_count_) {
         log::debug("one iteration of scheduler, time coroutines count: {}, fd coroutines count: {}", time_nodes_.size(), coro_count_ - time_nodes_.size());
         if (handle_expired_time_nodes_()) {
             continue;
         }
+        auto now = this->now();
+        if (now >= deadline) {
+            break;
+        }
+        if (virtual_) {
+            if (!advance_virtual_(deadline)) {
+                break;
+            }
+            continue;
+        }
         auto period = [&] {
-            auto now = std::chrono::steady_clock::now();
-            auto default_period = std::chrono::duration_cast<duration>(s_period);
-            if (!time_nodes_.empty() && time_nodes_.top().time <= now + default_period) {
+            auto period = std::min(std::chrono::duration_cast<duration>(s_period), deadline - now);
+            if (!time_nodes_.empty() && time_nodes_.top().time <= now + period) {
                 return time_nodes_.top().time - now;
             }
-            return default_period;
+            return period;
         }();
         if (coro_count_ > time_nodes_.size()) {
             handle_triggered_descriptor_nodes_(period);
@@ -68,33 +119,163 @@ auto scheduler::post_coro(int fd, event e, event &re, std::coroutine_handle<> co
     ++coro_count_;
 }
 
+auto scheduler::cancel(int fd) -> void {
+    if (fd <= 0 || static_cast<std::size_t>(fd) >= descriptor_nodes_.size()) {
+        return;
+    }
+    log::debug("cancel coroutines of fd: {}, count: {}", fd, descriptor_nodes_[fd].size());
+    descriptor_list list;
+    list.splice(list.end(), descriptor_nodes_[fd]);
+    auto it = list.begin();
+    while (it != list.end()) {
+        it->revent = CANCELED;
+        bool done = std::visit(utils::overload([&](std::coroutine_handle<> handle) {
+            trace::span span("cancel", fd, handle.address());
+            handle.resume();
+            return true;
+        }, [&](auto &proxy) {
+            trace::span span("cancel", fd);
+            return proxy();
+        }), it->next);
+        if (done) {
+            list.erase(it++);
+            --coro_count_;
+        }
+        else {
+            ++it;
+        }
+    }
+    descriptor_nodes_[fd].splice(descriptor_nodes_[fd].begin(), list);
+    update_descriptor_(fd);
+}
+
 auto scheduler::update_descriptor_(int fd) -> void {
     event e = NONE;
     for (auto &node : descriptor_nodes_[fd]) {
         e |= node.ev;
     }
-    poller_.subscribe(fd, e);
+    subscribe(fd, e);
+}
+
+auto scheduler::open_mailbox() -> void {
+    assert(!virtual_);
+    std::unique_lock lock(mailbox_mutex_);
+    assert(mailbox_fd_ == -1);
+    mailbox_fd_ = ::eventfd(mailbox_.size(), EFD_CLOEXEC | EFD_NONBLOCK);
+    if (mailbox_fd_ == -1) {
+        log::error("failed to create mailbox eventfd, errno: {}, message: {}", errno, ::strerror(errno));
+        throw utils::trans_error_code(errno);
+    }
+    lock.unlock();
+    mailbox_closed_ = false;
+    post_coro(mailbox_fd_, READ, mailbox_revent_, [this] {
+        return drain_mailbox_();
+    });
+}
+
+auto scheduler::post(std::move_only_function<auto () -> void> f) -> void {
+    std::unique_lock lock(mailbox_mutex_);
+    mailbox_.push_back(std::move(f));
+    if (mailbox_fd_ != -1 && mailbox_.size() == 1) {
+        std::uint64_t one = 1;
+        if (::write(mailbox_fd_, &one, sizeof(one)) == -1) {
+            log::error("failed to wake up mailbox, fd: {}, errno: {}, message: {}", mailbox_fd_, errno, ::strerror(errno));
+        }
+    }
+}
+
+auto scheduler::drain_mailbox_() -> bool {
+    std::uint64_t count;
+    if (::read(mailbox_fd_, &count, sizeof(count)) == -1 && errno != EAGAIN) {
+        log::error("failed to read mailbox, fd: {}, errno: {}, message: {}", mailbox_fd_, errno, ::strerror(errno));
+    }
+    std::vector<std::move_only_function<auto () -> void>> ready;
+    {
+        std::unique_lock lock(mailbox_mutex_);
+        ready.swap(mailbox_);
+    }
+    for (auto &f : ready) {
+        f();
+    }
+    return mailbox_closed_;
 }
 
 auto scheduler::handle_expired_time_nodes_() -> bool {
     size_t expired = 0;
-    while (!time_nodes_.empty() && time_nodes_.top().time <= std::chrono::steady_clock::now()) {
+    time_point first {};
+    while (!time_nodes_.empty() && time_nodes_.top().time <= now()) {
         assert(!time_nodes_.top().next.done());
-        auto handle = time_nodes_.top().next;
+        if (first == time_point {}) {
+            first = std::chrono::steady_clock::now();
+        }
+        auto [time, handle] = time_nodes_.top();
         time_nodes_.pop();
+        trace::span span("timer", -1, handle.address());
+        span.set_arg("lateness_ns", std::chrono::duration_cast<std::chrono::nanoseconds>(now() - time).count());
         handle.resume();
         ++expired;
         --coro_count_;
     }
     if (expired) {
+        record_busy_(std::chrono::steady_clock::now() - first);
         log::debug("handle {} expired time node(s)", expired);
     }
     return expired > 0;
 }
 
+auto scheduler::place_() -> void {
+    if (!pinned_ && !cpus_.empty()) {
+        if (auto ec = utils::pin_thread(::pthread_self(), cpus_)) {
+            log::error("failed to pin scheduler thread, cpus: {}, message: {}", cpus_, ec.message());
+            throw ec;
+        }
+        if (auto node = utils::cpus_node(cpus_); node != -1) {
+            if (auto ec = utils::prefer_node(node)) {
+                log::warning("failed to prefer numa node {}, message: {}", node, ec.message());
+            }
+        }
+        pinned_ = true;
+    }
+    placement_ = utils::thread_placement(::pthread_self());
+}
+
+auto scheduler::advance_virtual_(time_point deadline) -> bool {
+    auto &fake = std::get<fake_poller>(poller_);
+    if (coro_count_ > time_nodes_.size() && fake.deliverable()) {
+        handle_triggered_descriptor_nodes_(duration::zero());
+        return true;
+    }
+    if (!time_nodes_.empty()) {
+        virtual_now_ = std::min(time_nodes_.top().time, deadline);
+        return true;
+    }
+    if (deadline != time_point::max()) {
+        virtual_now_ = deadline;
+    }
+    log::debug("virtual scheduler is idle, fd coroutines count: {}", coro_count_);
+    return false;
+}
+
+namespace {
+
+thread_local scheduler *t_scheduler {nullptr};
+
+}
+
 auto default_scheduler() -> scheduler & {
+    if (t_scheduler) {
+        return *t_scheduler;
+    }
     static scheduler s_scheduler;
     return s_scheduler;
 }
 
+auto set_default_scheduler(scheduler &sched) -> void {
+    t_scheduler = &sched;
+}
+
+auto reset_default_scheduler() -> void {
+    t_scheduler = nullptr;
+}
+
 } /* namespace bc::async */
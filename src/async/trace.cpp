@@ -0,0 +1,119 @@
+#include <unistd.h>
+#include <chrono>
+#include <mutex>
+#include <vector>
+#include <fmt/format.h>
+
+#include <bc/async/trace.hpp>
+
+namespace bc::async::trace {
+
+namespace {
+
+struct registry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<detail::buffer>> buffers;
+};
+
+auto global_registry() -> registry & {
+    static registry s_registry;
+    return s_registry;
+}
+
+thread_local detail::buffer *t_buffer {nullptr};
+
+auto local_buffer() -> detail::buffer & {
+    if (!t_buffer) {
+        auto &reg = global_registry();
+        std::unique_lock lock(reg.mutex);
+        reg.buffers.push_back(std::make_unique<detail::buffer>(::gettid()));
+        t_buffer = reg.buffers.back().get();
+    }
+    return *t_buffer;
+}
+
+}
+
+auto enable(std::size_t capacity) -> void {
+    detail::g_capacity = capacity;
+    detail::g_enabled = true;
+}
+
+auto disable() -> void {
+    detail::g_enabled = false;
+    clear();
+}
+
+auto timestamp() noexcept -> std::uint64_t {
+    auto since = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(since).count();
+}
+
+auto emit(record const &r) noexcept -> void {
+    local_buffer().append(r);
+}
+
+auto dump(std::ostream &os) -> void {
+    auto &reg = global_registry();
+    std::unique_lock lock(reg.mutex);
+    auto pid = ::getpid();
+    std::string out = "{\"traceEvents\":[";
+    bool first = true;
+    auto separate = [&] {
+        if (!first) {
+            out += ",\n";
+        }
+        first = false;
+    };
+    for (auto const &buffer : reg.buffers) {
+        // nothing recorded since the last clear()
+        if (buffer->size() == 0 && buffer->dropped() == 0) {
+            continue;
+        }
+        separate();
+        out += fmt::format(R"({{"name":"thread_name","ph":"M","pid":{},"tid":{},"args":{{"name":"bc {}","dropped":{}}}}})",
+            pid, buffer->tid(), buffer->tid(), buffer->dropped());
+        auto size = buffer->size();
+        for (std::size_t i = 0; i < size; ++i) {
+            auto const &r = (*buffer)[i];
+            separate();
+            out += fmt::format(R"({{"name":"{}","cat":"bc","ph":"{}","ts":{:.3f},"pid":{},"tid":{})",
+                r.name, r.phase, r.ts / 1000.0, pid, buffer->tid());
+            if (r.phase == 'X') {
+                out += fmt::format(R"(,"dur":{:.3f})", r.dur / 1000.0);
+            }
+            else {
+                out += R"(,"s":"t")";
+            }
+            out += fmt::format(R"(,"args":{{"fd":{},"task":"{:#x}")", r.fd, r.task);
+            if (r.arg_name) {
+                out += fmt::format(R"(,"{}":{})", r.arg_name, r.arg);
+            }
+            out += "}}";
+        }
+        os << out;
+        out.clear();
+    }
+    out += "],\"displayTimeUnit\":\"ns\"}\n";
+    os << out;
+}
+
+auto clear() -> void {
+    auto &reg = global_registry();
+    std::unique_lock lock(reg.mutex);
+    for (auto &buffer : reg.buffers) {
+        buffer->release();
+    }
+}
+
+auto dropped() -> std::size_t {
+    auto &reg = global_registry();
+    std::unique_lock lock(reg.mutex);
+    std::size_t total = 0;
+    for (auto const &buffer : reg.buffers) {
+        total += buffer->dropped();
+    }
+    return total;
+}
+
+} /* namespace bc::async::trace */
@@ -0,0 +1,393 @@
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+
+#include <bc/utils/error.hpp>
+#include <bc/http/parser.hpp>
+
+namespace bc::http {
+
+namespace {
+
+/*
+ * Each scanner returns the first byte at or after p that is a control
+ * character other than tab, DEL, or stop, and end if there is none.
+ */
+using scanner = auto (*)(char const *p, char const *end, char stop) -> char const *;
+
+auto is_stop(unsigned char c, char stop) -> bool {
+    return (c < 0x20 && c != '\t') || c == 0x7f || c == static_cast<unsigned char>(stop);
+}
+
+auto scan_scalar(char const *p, char const *end, char stop) -> char const * {
+    for (; p < end; ++p) {
+        if (is_stop(*p, stop)) {
+            return p;
+        }
+    }
+    return end;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+/*
+ * pcmpestri in ranges mode tests 16 bytes against every range at once.
+ */
+[[gnu::target("sse4.2")]]
+auto scan_sse42(char const *p, char const *end, char stop) -> char const * {
+    alignas(16) char const ranges[16] {'\x00', '\x08', '\x0a', '\x1f', '\x7f', '\x7f', stop, stop};
+    auto r = _mm_load_si128(reinterpret_cast<__m128i const *>(ranges));
+    for (; end - p >= 16; p += 16) {
+        auto v = _mm_loadu_si128(reinterpret_cast<__m128i const *>(p));
+        int i = _mm_cmpestri(r, 8, v, 16, _SIDD_UBYTE_OPS | _SIDD_CMP_RANGES | _SIDD_LEAST_SIGNIFICANT);
+        if (i != 16) {
+            return p + i;
+        }
+    }
+    return scan_scalar(p, end, stop);
+}
+
+[[gnu::target("avx2")]]
+auto scan_avx2(char const *p, char const *end, char stop) -> char const * {
+    auto const ctl = _mm256_set1_epi8(0x1f);
+    auto const tab = _mm256_set1_epi8('\t');
+    auto const del = _mm256_set1_epi8(0x7f);
+    auto const st = _mm256_set1_epi8(stop);
+    for (; end - p >= 32; p += 32) {
+        auto v = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(p));
+        // unsigned v <= 0x1f, as avx2 only compares signed bytes
+        auto hit = _mm256_cmpeq_epi8(_mm256_min_epu8(v, ctl), v);
+        hit = _mm256_andnot_si256(_mm256_cmpeq_epi8(v, tab), hit);
+        hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, del));
+        hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, st));
+        if (auto mask = static_cast<std::uint32_t>(_mm256_movemask_epi8(hit))) {
+            return p + std::countr_zero(mask);
+        }
+    }
+    return scan_sse42(p, end, stop);
+}
+
+#endif
+
+auto best_backend() -> scan_backend {
+#if defined(__x86_64__) || defined(__i386__)
+    // may run from static initialization, ahead of the cpu model's own
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return scan_backend::AVX2;
+    }
+    if (__builtin_cpu_supports("sse4.2")) {
+        return scan_backend::SSE42;
+    }
+#endif
+    return scan_backend::SCALAR;
+}
+
+auto scanner_of(scan_backend backend) -> scanner {
+    switch (backend) {
+#if defined(__x86_64__) || defined(__i386__)
+    case scan_backend::AVX2:
+        return scan_avx2;
+    case scan_backend::SSE42:
+        return scan_sse42;
+#endif
+    default:
+        return scan_scalar;
+    }
+}
+
+std::atomic<scan_backend> g_backend {best_backend()};
+std::atomic<scanner> g_scan {scanner_of(g_backend.load())};
+
+/*
+ * tchar of RFC 9110, the characters of methods and header names.
+ */
+constexpr auto s_token = [] {
+    std::array<bool, 256> table {};
+    for (int c = '0'; c <= '9'; ++c) {
+        table[c] = true;
+    }
+    for (int c = 'a'; c <= 'z'; ++c) {
+        table[c] = table[c - 'a' + 'A'] = true;
+    }
+    for (char c : std::string_view("!#$%&'*+-.^_`|~")) {
+        table[static_cast<unsigned char>(c)] = true;
+    }
+    return table;
+}();
+
+auto is_token(char c) -> bool {
+    return s_token[static_cast<unsigned char>(c)];
+}
+
+auto lower(char c) -> char {
+    return c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c;
+}
+
+auto iequals(std::string_view a, std::string_view b) -> bool {
+    return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) { return lower(x) == lower(y); });
+}
+
+auto trim(std::string_view s) -> std::string_view {
+    while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) {
+        s.remove_prefix(1);
+    }
+    while (!s.empty() && (s.back() == ' ' || s.back() == '\t')) {
+        s.remove_suffix(1);
+    }
+    return s;
+}
+
+/*
+ * Calls f with each element of a comma-separated list, blanks trimmed.
+ */
+template <typename F>
+auto for_each_element(std::string_view list, F &&f) -> void {
+    while (!list.empty()) {
+        auto pos = list.find(',');
+        if (auto element = trim(list.substr(0, pos)); !element.empty()) {
+            f(element);
+        }
+        list = pos == std::string_view::npos ? std::string_view {} : list.substr(pos + 1);
+    }
+}
+
+enum class outcome {
+    DONE,
+    PARTIAL,
+    BAD,
+    TOO_LARGE,
+};
+
+class head_parser {
+public:
+    head_parser(char const *begin, char const *end, request &req, limits const &limits) : p_(begin), end_(end), req_(req), limits_(limits), scan_(g_scan.load(std::memory_order_relaxed)) {}
+
+    auto parse() -> outcome {
+        // a server should ignore empty lines ahead of the request line
+        while (p_ < end_ && (*p_ == '\r' || *p_ == '\n')) {
+            ++p_;
+        }
+        if (auto res = request_line_(); res != outcome::DONE) {
+            return res;
+        }
+        while (true) {
+            if (p_ == end_) {
+                return outcome::PARTIAL;
+            }
+            if (*p_ == '\r' || *p_ == '\n') {
+                if (auto res = line_end_(); res != outcome::DONE) {
+                    return res;
+                }
+                return interpret_();
+            }
+            if (req_.headers.size() == limits_.max_headers) {
+                return outcome::TOO_LARGE;
+            }
+            if (auto res = header_(); res != outcome::DONE) {
+                return res;
+            }
+        }
+    }
+
+    auto position() const -> char const * { return p_; }
+
+private:
+    auto request_line_() -> outcome {
+        auto const *method = p_;
+        while (p_ < end_ && is_token(*p_)) {
+            ++p_;
+        }
+        if (p_ == end_) {
+            return outcome::PARTIAL;
+        }
+        if (p_ == method || *p_ != ' ') {
+            return outcome::BAD;
+        }
+        req_.method = {method, p_};
+
+        auto const *target = ++p_;
+        p_ = scan_(p_, end_, ' ');
+        if (p_ == end_) {
+            return outcome::PARTIAL;
+        }
+        if (p_ == target || *p_ != ' ') {
+            return outcome::BAD;
+        }
+        req_.target = {target, p_};
+
+        ++p_;
+        constexpr std::string_view version = "HTTP/1.";
+        auto n = std::min<std::size_t>(end_ - p_, version.size());
+        if (std::string_view(p_, n) != version.substr(0, n)) {
+            return outcome::BAD;
+        }
+        if (static_cast<std::size_t>(end_ - p_) <= version.size()) {
+            return outcome::PARTIAL;
+        }
+        p_ += version.size();
+        if (*p_ != '0' && *p_ != '1') {
+            return outcome::BAD;
+        }
+        req_.minor_version = *p_++ - '0';
+        // persistent by default from HTTP/1.1 on
+        req_.keep_alive = req_.minor_version == 1;
+        return line_end_();
+    }
+
+    auto header_() -> outcome {
+        auto const *name = p_;
+        while (p_ < end_ && is_token(*p_)) {
+            ++p_;
+        }
+        if (p_ == end_) {
+            return outcome::PARTIAL;
+        }
+        // also rejects obsolete line folding, which starts with a blank
+        if (p_ == name || *p_ != ':') {
+            return outcome::BAD;
+        }
+        std::string_view header_name {name, p_};
+
+        ++p_;
+        auto const *value = p_;
+        p_ = scan_(p_, end_, '\0');
+        if (p_ == end_) {
+            return outcome::PARTIAL;
+        }
+        std::string_view header_value = trim({value, p_});
+        if (auto res = line_end_(); res != outcome::DONE) {
+            return res;
+        }
+        req_.headers.push_back({header_name, header_value});
+        return outcome::DONE;
+    }
+
+    /*
+     * CRLF, or a bare LF as tolerated by RFC 9112.
+     */
+    auto line_end_() -> outcome {
+        if (p_ == end_) {
+            return outcome::PARTIAL;
+        }
+        if (*p_ == '\r') {
+            if (++p_ == end_) {
+                return outcome::PARTIAL;
+            }
+        }
+        if (*p_ != '\n') {
+            return outcome::BAD;
+        }
+        ++p_;
+        return outcome::DONE;
+    }
+
+    /*
+     * Framing and persistence from the headers that decide them.
+     */
+    auto interpret_() -> outcome {
+        std::optional<std::size_t> length;
+        for (auto const &[name, value] : req_.headers) {
+            if (iequals(name, "content-length")) {
+                std::size_t n = 0;
+                if (value.empty() || value.size() > 15 || !std::all_of(value.begin(), value.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+                    return outcome::BAD;
+                }
+                for (char c : value) {
+                    n = n * 10 + (c - '0');
+                }
+                if (length && *length != n) {
+                    return outcome::BAD;
+                }
+                length = n;
+            }
+            else if (iequals(name, "transfer-encoding")) {
+                bool chunked = false;
+                for_each_element(value, [&](std::string_view coding) {
+                    chunked = iequals(coding, "chunked");
+                });
+                // chunked must be the final coding of a request
+                if (!chunked) {
+                    return outcome::BAD;
+                }
+                req_.chunked = true;
+            }
+            else if (iequals(name, "connection")) {
+                for_each_element(value, [&](std::string_view option) {
+                    if (iequals(option, "close")) {
+                        req_.keep_alive = false;
+                    }
+                    else if (iequals(option, "keep-alive") && req_.minor_version == 0) {
+                        req_.keep_alive = true;
+                    }
+                });
+            }
+        }
+        // both at once is how requests get smuggled past proxies
+        if (req_.chunked && length) {
+            return outcome::BAD;
+        }
+        req_.content_length = length.value_or(0);
+        return outcome::DONE;
+    }
+
+private:
+    char const *p_;
+    char const *end_;
+    request &req_;
+    limits const &limits_;
+    scanner scan_;
+};
+
+} /* namespace bc::http::<anonymous> */
+
+auto set_scan_backend(scan_backend backend) -> void {
+    backend = std::min(backend, best_backend());
+    g_backend.store(backend, std::memory_order_relaxed);
+    g_scan.store(scanner_of(backend), std::memory_order_relaxed);
+}
+
+auto current_scan_backend() -> scan_backend {
+    return g_backend.load(std::memory_order_relaxed);
+}
+
+auto request::header(std::string_view name) const -> std::optional<std::string_view> {
+    for (auto const &h : headers) {
+        if (iequals(h.name, name)) {
+            return h.value;
+        }
+    }
+    return std::nullopt;
+}
+
+auto parse_request(std::span<char const> data, request &req, limits const &limits) -> utils::expected<std::size_t, std::error_code> {
+    req.headers.clear();
+    req.content_length = 0;
+    req.chunked = false;
+    req.body = {};
+
+    // nothing past the limit is looked at, so an endless head costs no more
+    auto size = std::min(data.size(), limits.max_header_bytes);
+    head_parser parser(data.data(), data.data() + size, req, limits);
+    switch (parser.parse()) {
+    case outcome::DONE:
+        return static_cast<std::size_t>(parser.position() - data.data());
+    case outcome::PARTIAL:
+        if (data.size() >= limits.max_header_bytes) {
+            return utils::trans_error_code(utils::detail::message_size);
+        }
+        return 0;
+    case outcome::BAD:
+        return utils::trans_error_code(utils::detail::bad_message);
+    case outcome::TOO_LARGE:
+        return utils::trans_error_code(utils::detail::message_size);
+    }
+    return 0;
+}
+
+} /* namespace bc::http */
@@ -0,0 +1,132 @@
+#include <charconv>
+#include <ctime>
+
+#include <bc/http/response.hpp>
+
+namespace bc::http {
+
+namespace {
+
+/*
+ * The Date header value, formatted again only when the second changes.
+ */
+auto http_date() -> std::string_view {
+    thread_local std::time_t cached {0};
+    thread_local char buffer[32];
+    thread_local std::size_t size {0};
+    auto now = std::time(nullptr);
+    if (now != cached) {
+        std::tm tm;
+        ::gmtime_r(&now, &tm);
+        size = std::strftime(buffer, sizeof(buffer), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+        cached = now;
+    }
+    return {buffer, size};
+}
+
+/*
+ * 1xx, 204 and 304 responses never carry a body or its length.
+ */
+auto has_body(unsigned status) -> bool {
+    return status >= 200 && status != 204 && status != 304;
+}
+
+} /* namespace bc::http::<anonymous> */
+
+auto reason_phrase(unsigned status) -> std::string_view {
+    switch (status) {
+    case 100: return "Continue";
+    case 101: return "Switching Protocols";
+    case 200: return "OK";
+    case 201: return "Created";
+    case 202: return "Accepted";
+    case 204: return "No Content";
+    case 206: return "Partial Content";
+    case 301: return "Moved Permanently";
+    case 302: return "Found";
+    case 303: return "See Other";
+    case 304: return "Not Modified";
+    case 307: return "Temporary Redirect";
+    case 308: return "Permanent Redirect";
+    case 400: return "Bad Request";
+    case 401: return "Unauthorized";
+    case 403: return "Forbidden";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 408: return "Request Timeout";
+    case 409: return "Conflict";
+    case 411: return "Length Required";
+    case 413: return "Content Too Large";
+    case 414: return "URI Too Long";
+    case 415: return "Unsupported Media Type";
+    case 429: return "Too Many Requests";
+    case 431: return "Request Header Fields Too Large";
+    case 500: return "Internal Server Error";
+    case 501: return "Not Implemented";
+    case 502: return "Bad Gateway";
+    case 503: return "Service Unavailable";
+    case 504: return "Gateway Timeout";
+    default: return {};
+    }
+}
+
+auto response_batch::append(response &&res, bool keep_alive, bool head_only) -> void {
+    char number[20];
+    auto status = res.status_;
+    data_.append("HTTP/1.1 ").append(number, std::to_chars(number, number + sizeof(number), status).ptr);
+    data_.append(" ").append(reason_phrase(status)).append("\r\nDate: ").append(http_date()).append("\r\n");
+    auto body = has_body(status) ? res.body() : std::string_view {};
+    if (has_body(status)) {
+        data_.append("Content-Length: ").append(number, std::to_chars(number, number + sizeof(number), body.size()).ptr).append("\r\n");
+    }
+    if (!keep_alive) {
+        data_.append("Connection: close\r\n");
+    }
+    data_.append(res.headers_).append("\r\n");
+    if (head_only || body.empty()) {
+        return;
+    }
+    if (body.size() <= s_copy_threshold) {
+        data_.append(body);
+        return;
+    }
+    seal_();
+    if (res.owns_) {
+        auto &owned = owned_.emplace_back(std::move(res.owned_));
+        body = owned;
+    }
+    segments_.push_back({body.data(), 0, body.size()});
+}
+
+auto response_batch::buffers() -> std::span<std::span<char const> const> {
+    seal_();
+    buffers_.clear();
+    for (auto const &segment : segments_) {
+        if (segment.external) {
+            buffers_.emplace_back(segment.external, segment.size);
+        }
+        else {
+            buffers_.emplace_back(data_.data() + segment.offset, segment.size);
+        }
+    }
+    return buffers_;
+}
+
+auto response_batch::clear() -> void {
+    data_.clear();
+    mark_ = 0;
+    segments_.clear();
+    owned_.clear();
+}
+
+/*
+ * Ends the run of copied bytes, before a body referenced in place.
+ */
+auto response_batch::seal_() -> void {
+    if (data_.size() > mark_) {
+        segments_.push_back({nullptr, mark_, data_.size() - mark_});
+        mark_ = data_.size();
+    }
+}
+
+} /* namespace bc::http */
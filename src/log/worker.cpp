@@ -3,14 +3,25 @@
 #include <map>
 #include <string>
 
+#include <bc/log/log.hpp>
 #include <bc/log/logger.hpp>
 #include <bc/log/worker.hpp>
+#include <bc/utils/memory.hpp>
 
 namespace bc::log {
 
+namespace {
+
+auto record_bytes(record const &record) -> std::size_t {
+    return sizeof(std::pair<logger const &, log::record>) + record.message.capacity();
+}
+
+}
+
 auto worker::append(logger const &logger, record &&record) -> void {
     assert(!stop_);
     bool need_flush = false;
+    utils::memory::add(utils::memory::category::LOG_RECORDS, record_bytes(record));
     {
         std::unique_lock lock(mutex_);
         logs_.emplace_back(logger, std::move(record));
@@ -23,33 +34,52 @@ auto worker::append(logger const &logger, record &&record) -> void {
 
 auto worker::flush() -> void {
     assert(!stop_);
-    std::mutex mutex;
-    std::condition_variable cv;
-    std::atomic_bool flushed {false};
+    std::binary_semaphore flushed {0};
+    {
+        std::unique_lock lock(mutex_);
+        waiters_.push_back(&flushed);
+    }
+    cv_.notify_one();
+    flushed.acquire();
+}
+
+auto worker::set_affinity(std::vector<int> const &cpus) -> void {
+    if (auto ec = utils::pin_thread(thread_.native_handle(), cpus)) {
+        throw ec;
+    }
     {
+        // under the lock, so the change cannot slip in before the loop waits
         std::unique_lock lock(mutex_);
-        waiters_.emplace_back(cv, flushed);
+        node_ = utils::cpus_node(cpus);
     }
     cv_.notify_one();
+}
 
-    std::unique_lock lock(mutex);
-    cv_.wait(lock, [&] -> bool {
-        return flushed;
-    });
+auto worker::placement() -> utils::placement {
+    return utils::thread_placement(thread_.native_handle());
 }
 
 auto worker::loop_() -> void {
+    int node = -1;
     while (!stop_) {
         logs ready;
         std::vector<waiter> waiters;
         {
             std::unique_lock lock(mutex_);
-            cv_.wait_for(lock, std::chrono::seconds(10), [this] {
-                return !logs_.empty() || stop_;
+            cv_.wait_for(lock, std::chrono::seconds(10), [&] {
+                return !logs_.empty() || !waiters_.empty() || stop_ || node_ != node;
             });
             logs_.swap(ready);
             waiters.swap(waiters_);
         }
+        if (node != node_) {
+            node = node_;
+            if (node != -1) {
+                if (auto ec = utils::prefer_node(node)) {
+                    log::warning("failed to prefer numa node {} for the log thread, message: {}", node, ec.message());
+                }
+            }
+        }
         drain_(ready, waiters);
     }
     drain_(logs_, waiters_);
@@ -64,14 +94,20 @@ auto worker::drain_(logs &logs, std::vector<waiter> &waiters) -> void {
         buffers[&logger] += logger.formatter().format(record.timestamp, record.lv, record.topic, record.tid, record.location, record.message);
         buffers[&logger] += "\n";
         logger.unreference_();
+        utils::memory::sub(utils::memory::category::LOG_RECORDS, record_bytes(record));
+    }
+    std::size_t formatted = 0;
+    for (auto const &[plogger, buffer] : buffers) {
+        formatted += buffer.capacity();
     }
+    utils::memory::add(utils::memory::category::LOG_FORMATTER, formatted, buffers.size());
     for (auto const &[plogger, buffer] : buffers) {
         plogger->backend().write(buffer);
         plogger->unreference_();
     }
-    for (auto &[cv, flushed] : waiters) {
-        flushed = true;
-        cv.notify_one();
+    utils::memory::sub(utils::memory::category::LOG_FORMATTER, formatted, buffers.size());
+    for (auto *flushed : waiters) {
+        flushed->release();
     }
 }
 